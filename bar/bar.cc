@@ -14,6 +14,7 @@
 #include "nwg_classes.h"
 #include "nwg_tools.h"
 #include "on_event.h"
+#include "task_graph.h"
 #include "bar.h"
 
 RGBA background = {0.0, 0.0, 0.0, 0.9};
@@ -43,7 +44,7 @@ int main(int argc, char *argv[]) {
     gettimeofday(&tp, NULL);
     long int start_ms = tp.tv_sec * 1000 + tp.tv_usec / 1000;
 
-    create_pid_file_or_kill_pid("nwgbar");
+    ensure_single_instance("nwgbar");
 
     std::string lang ("");
 
@@ -126,66 +127,78 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    std::string config_dir = get_config_dir("nwgbar");
-    if (!fs::is_directory(config_dir)) {
-        std::cout << "Config dir not found, creating...\n";
-        fs::create_directories(config_dir);
+    /* get current WM name if not forced */
+    if (wm.empty()) {
+        wm = detect_wm();
     }
 
+    std::cout << "WM: " << wm << "\n";
+
+    std::string config_dir = get_config_dir("nwgbar");
     // default and custom style sheet
     std::string default_css_file = config_dir + "/style.css";
     // css file to be used
     std::string css_file = config_dir + "/" + custom_css_file;
-    // copy default file if not found
-    if (!fs::exists(default_css_file)) {
-        try {
-            fs::copy_file(DATA_DIR_STR "/nwgbar/style.css", default_css_file, fs::copy_options::overwrite_existing);
-        } catch (...) {
-            std::cerr << "Failed copying default style.css\n";
-        }
-    }
-
     // default or custom template
     std::string default_bar_file = config_dir + "/bar.json";
     std::string custom_bar_file = config_dir + "/" + definition_file;
-    // copy default anyway if not found
-    if (!fs::exists(default_bar_file)) {
-        try {
-            fs::copy_file(DATA_DIR_STR "/nwgbar/bar.json", default_bar_file, fs::copy_options::overwrite_existing);
-        } catch (...) {
-            std::cerr << "Failed copying default template\n";
-        }
-    }
-
-    ns::json bar_json {};
-    try {
-        bar_json = get_bar_json(std::move(custom_bar_file));
-    }  catch (...) {
-        std::cerr << "\nERROR: Template file not found, using default\n";
-        bar_json = get_bar_json(default_bar_file);
-    }
-    std::cout << bar_json.size() << " bar entries loaded\n";
 
     std::vector<BarEntry> bar_entries {};
-    if (bar_json.size() > 0) {
-        bar_entries = get_bar_entries(std::move(bar_json));
-    }
+    std::optional<Geometry> sway_output;
 
-    /* get current WM name if not forced */
-    if (wm.empty()) {
-        wm = detect_wm();
-    }
+    /* Phases below run on worker threads while GTK initializes, data is joined where needed;
+     * the data is declared above, so that it outlives the tasks */
+    init_locale();
+    TaskGraph tasks;
 
-    std::cout << "WM: " << wm << "\n";
+    auto config_task = tasks.add("config", [&] {
+        if (!fs::is_directory(config_dir)) {
+            std::cout << "Config dir not found, creating...\n";
+            fs::create_directories(config_dir);
+        }
+        // copy default file if not found
+        if (!fs::exists(default_css_file)) {
+            try {
+                fs::copy_file(DATA_DIR_STR "/nwgbar/style.css", default_css_file, fs::copy_options::overwrite_existing);
+            } catch (...) {
+                std::cerr << "Failed copying default style.css\n";
+            }
+        }
+        // copy default anyway if not found
+        if (!fs::exists(default_bar_file)) {
+            try {
+                fs::copy_file(DATA_DIR_STR "/nwgbar/bar.json", default_bar_file, fs::copy_options::overwrite_existing);
+            } catch (...) {
+                std::cerr << "Failed copying default template\n";
+            }
+        }
+    });
 
-    /* turn off borders, enable floating on sway */
-    if (wm == "sway") {
-        auto* cmd = "swaymsg for_window [title=\"~nwgbar*\"] floating enable";
-        std::system(cmd);
-        cmd = "swaymsg for_window [title=\"~nwgbar*\"] border none";
-        std::system(cmd);
-    }
+    auto template_task = tasks.add("template", [&] {
+        try {
+            bar_entries = get_bar_entries(custom_bar_file);
+        }  catch (...) {
+            std::cerr << "\nERROR: Template file not found or invalid, using default\n";
+            bar_entries = get_bar_entries(default_bar_file);
+        }
+        std::cout << bar_entries.size() << " bar entries loaded\n";
+    }, {config_task});
+
+    /* turn off borders, enable floating on sway; get the focused output meanwhile */
+    auto sway_task = tasks.add("sway", [&] {
+        if (wm == "sway") {
+            auto* cmd = "swaymsg for_window [title=\"~nwgbar*\"] floating enable";
+            std::system(cmd);
+            cmd = "swaymsg for_window [title=\"~nwgbar*\"] border none";
+            std::system(cmd);
+        }
+        sway_output = focused_output_geometry(wm);
+    });
 
+    tasks.run();
+
+    std::optional<TaskGraph::Phase> gtk_phase;
+    gtk_phase.emplace(tasks, "gtk");
     Gtk::Main kit(argc, argv);
 
     auto provider = Gtk::CssProvider::create();
@@ -203,6 +216,7 @@ int main(int argc, char *argv[]) {
     }
     auto& icon_theme_ref = *icon_theme.get();
 
+    tasks.wait(config_task);
     if (std::filesystem::is_regular_file(css_file)) {
         provider->load_from_path(css_file);
         std::cout << "Using " << css_file << '\n';
@@ -211,13 +225,16 @@ int main(int argc, char *argv[]) {
         std::cout << "Using " << default_css_file << '\n';
     }
 
+    // the window rules must be in place before the window shows up
+    tasks.wait(sway_task);
     MainWindow window;
     window.show();
 
     window.signal_button_press_event().connect(sigc::ptr_fun(&on_window_clicked));
 
     /* Detect focused display geometry: {x, y, width, height} */
-    auto geometry = display_geometry(wm, display, window.get_window());
+    auto geometry = display_geometry(sway_output, display, window.get_window());
+    gtk_phase.reset();
     std::cout << "Focused display: " << geometry.x << ", " << geometry.y << ", " << geometry.width << ", "
     << geometry.height << '\n';
 
@@ -234,14 +251,19 @@ int main(int argc, char *argv[]) {
     Gtk::Box outer_box(Gtk::ORIENTATION_VERTICAL);
     outer_box.set_spacing(15);
 
-    /* Create buttons */
+    window.orientation = orientation;
+    window.icon_theme = icon_theme;
+
+    /* Create buttons, group members are only built when the group gets expanded */
+    tasks.wait(template_task);
+    window.boxes.reserve(bar_entries.size());
     for (auto& entry : bar_entries) {
         Gtk::Image* image = app_image(icon_theme_ref, entry.icon);
-        auto& ab = window.boxes.emplace_back(std::move(entry.name),
-                                             std::move(entry.exec),
-                                             std::move(entry.icon));
+        // bar_entries own the text and outlive the window
+        auto& ab = window.boxes.emplace_back(entry.name, entry.exec, entry.icon);
         ab.set_image_position(Gtk::POS_TOP);
         ab.set_image(*image);
+        ab.group = std::move(entry.items);
     }
 
     int column = 0;
@@ -260,14 +282,20 @@ int main(int argc, char *argv[]) {
 
     Gtk::VBox inner_vbox;
 
+    // expanded group members go below a horizontal bar, or next to a vertical one
+    Gtk::Box bar_box(orientation == "v" ? Gtk::ORIENTATION_HORIZONTAL : Gtk::ORIENTATION_VERTICAL);
+    bar_box.set_spacing(5);
+    bar_box.pack_start(window.favs_grid, false, false);
+    bar_box.pack_start(window.group_grid, false, false);
+
     Gtk::HBox favs_hbox;
     favs_hbox.set_name("bar");
     if (h_align == "l") {
-        favs_hbox.pack_start(window.favs_grid, false, false);
+        favs_hbox.pack_start(bar_box, false, false);
     } else if (h_align == "r") {
-        favs_hbox.pack_end(window.favs_grid, false, false);
+        favs_hbox.pack_end(bar_box, false, false);
     } else {
-        favs_hbox.pack_start(window.favs_grid, true, false);
+        favs_hbox.pack_start(bar_box, true, false);
     }
 
     inner_vbox.pack_start(favs_hbox, true, false);
@@ -282,11 +310,17 @@ int main(int argc, char *argv[]) {
 
     window.add(outer_box);
     window.show_all_children();
+    window.group_grid.hide();
 
     gettimeofday(&tp, NULL);
     long int end_ms = tp.tv_sec * 1000 + tp.tv_usec / 1000;
 
     std::cout << "Time: " << end_ms - start_ms << "ms\n";
+    tasks.print_trace(std::cout, getenv("NWG_TRACE") != nullptr);
+
+    watch_instance_messages([]() {
+        Gtk::Main::quit();
+    });
 
     Gtk::Main::run(window);
 
@@ -14,6 +14,7 @@
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <list>
 
 #include <gtkmm.h>
 #include <glibmm/ustring.h>
@@ -28,11 +29,22 @@ namespace ns = nlohmann;
 
 extern std::string wm;
 
+struct BarEntry {
+    std::string name;
+    std::string exec;
+    std::string icon;
+    std::vector<BarEntry> items {};     // group members, empty for plain entries
+    BarEntry(std::string, std::string, std::string);
+};
+
 class BarBox : public AppBox {
 public:
-    BarBox(Glib::ustring, Glib::ustring, Glib::ustring);
+    BarBox(std::string_view, std::string_view, std::string_view);
     bool on_button_press_event(GdkEventButton*) override;
     void on_activate() override;
+
+    std::vector<BarEntry> group {};     // group members, their boxes are built on first expansion
+    std::list<BarBox> group_boxes {};
 };
 
 class MainWindow : public CommonWindow {
@@ -44,21 +56,20 @@ class MainWindow : public CommonWindow {
         std::vector<BarBox> all_boxes {};        // attached to apps_grid unfiltered view
         std::vector<BarBox> filtered_boxes {};   // attached to apps_grid filtered view
         std::vector<BarBox> boxes {};            // attached to favs_grid
+        Gtk::Grid group_grid;                   // members of the expanded group
+        std::string orientation {"h"};
+        Glib::RefPtr<Gtk::IconTheme> icon_theme;
+
+        void toggle_group(BarBox&);
 
     private:
         //Override default signal handler:
         bool on_key_press_event(GdkEventKey* event) override;
-};
 
-struct BarEntry {
-    std::string name;
-    std::string exec;
-    std::string icon;
-    BarEntry(std::string, std::string, std::string);
+        BarBox* expanded {nullptr};             // group shown in group_grid
 };
 
 /*
  * Function declarations
  * */
-ns::json get_bar_json(const std::string&);
-std::vector<BarEntry> get_bar_entries(ns::json&&);
+std::vector<BarEntry> get_bar_entries(const std::string&);
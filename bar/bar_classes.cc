@@ -14,12 +14,18 @@
  * Re-worked for Gtkmm 3.0 by Louis Melahn, L.C. January 31, 2014.
  * */
 
+#include "nwg_tools.h"
 #include "bar.h"
 
 MainWindow::MainWindow(): CommonWindow("~nwgbar", "~nwgbar") {
     favs_grid.set_column_spacing(5);
     favs_grid.set_row_spacing(5);
     favs_grid.set_column_homogeneous(true);
+    group_grid.set_column_spacing(5);
+    group_grid.set_row_spacing(5);
+    group_grid.set_column_homogeneous(true);
+    group_grid.set_halign(Gtk::ALIGN_CENTER);
+    group_grid.set_valign(Gtk::ALIGN_CENTER);
 
     // We can not go fullscreen() here:
     // On sway the window would become opaque - we don't wat it
@@ -41,6 +47,45 @@ bool MainWindow::on_key_press_event(GdkEventKey* key_event) {
     return Gtk::Window::on_key_press_event(key_event);
 }
 
+/*
+ * Shows or hides group members next to the bar, building their buttons on first expansion
+ * */
+void MainWindow::toggle_group(BarBox& group) {
+    for (Gtk::Widget *widget : group_grid.get_children()) {
+        group_grid.remove(*widget);
+    }
+    if (expanded == &group) {
+        expanded = nullptr;
+        group_grid.hide();
+        return;
+    }
+    expanded = &group;
+
+    if (group.group_boxes.empty()) {
+        for (auto& entry : group.group) {
+            Gtk::Image* image = app_image(*icon_theme.get(), entry.icon);
+            auto& ab = group.group_boxes.emplace_back(entry.name, entry.exec, entry.icon);
+            ab.set_image_position(Gtk::POS_TOP);
+            ab.set_image(*image);
+            ab.group = std::move(entry.items);
+        }
+    }
+
+    int column = 0;
+    int row = 0;
+    group_grid.freeze_child_notify();
+    for (auto& box : group.group_boxes) {
+        group_grid.attach(box, column, row, 1, 1);
+        if (orientation == "v") {
+            row++;
+        } else {
+            column++;
+        }
+    }
+    group_grid.thaw_child_notify();
+    group_grid.show_all();
+}
+
 /*
  * Constructor is required for std::vector::emplace_back to work
  * It is not needed when compiling with C++20 and greater
@@ -48,8 +93,8 @@ bool MainWindow::on_key_press_event(GdkEventKey* key_event) {
 BarEntry::BarEntry(std::string name, std::string exec, std::string icon)
  : name(std::move(name)), exec(std::move(exec)), icon(std::move(icon)) {}
 
-BarBox::BarBox(Glib::ustring name, Glib::ustring exec, Glib::ustring comment)
- : AppBox(std::move(name), std::move(exec), std::move(comment)) {}
+BarBox::BarBox(std::string_view name, std::string_view exec, std::string_view comment)
+ : AppBox(name, exec, comment) {}
 
 bool BarBox::on_button_press_event(GdkEventButton* event) {
     (void)event; // suppress warning
@@ -59,8 +104,16 @@ bool BarBox::on_button_press_event(GdkEventButton* event) {
 }
 
 void BarBox::on_activate() {
-    exec.append(" &");
-    const char *command = exec.c_str();
+    if (!group.empty()) {
+        auto toplevel = dynamic_cast<MainWindow*>(this->get_toplevel());
+        if (toplevel) {
+            toplevel->toggle_group(*this);
+        }
+        return;
+    }
+    std::string cmd {exec};
+    cmd.append(" &");
+    const char *command = cmd.c_str();
     std::system(command);
 
     Gtk::Main::quit();
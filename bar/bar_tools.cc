@@ -10,26 +10,97 @@
 #include "bar.h"
 
 /*
- * Returns json object out of a template file
+ * Returns a vector of BarEntry data structs out of a template file; entries with "items" are groups.
+ * Only the known keys are picked up while parsing, throws if the template is invalid
  * */
-ns::json get_bar_json(const std::string& custom_bar) {
-    std::string bar_string = read_file_to_string(custom_bar);
+std::vector<BarEntry> get_bar_entries(const std::string& bar_file) {
+    struct TemplateReader : JsonSaxReader {
+        struct OpenEntry {
+            BarEntry entry {"", "", ""};
+            bool has_name = false;
+            bool has_exec = false;
+            bool has_items = false;
+        };
+        std::vector<BarEntry> entries {};   // top level ones
+        std::vector<OpenEntry> open {};     // entries being read, innermost last
+        std::vector<bool> in_array {};      // nesting of entry arrays (true) and entries (false)
+        std::string last_key {};
+        int skipped = 0;                    // depth inside a value of an unknown key
+        bool valid = true;
 
-    return string_to_json(bar_string);
-}
-
-/*
- * Returns a vector of BarEntry data structs
- * */
-std::vector<BarEntry> get_bar_entries(ns::json&& bar_json) {
-    // read from json object
-    std::vector<BarEntry> entries {};
-    for (auto&& json : bar_json) {
-        entries.emplace_back(std::move(json.at("name")),
-                             std::move(json.at("exec")),
-                             std::move(json.at("icon")));
+        bool key(std::string& key) {
+            last_key = std::move(key);
+            return true;
+        }
+        bool string(std::string& value) {
+            if (skipped == 0 && !in_array.empty() && !in_array.back()) {
+                auto& current = open.back();
+                if (last_key == "name") {
+                    current.entry.name = std::move(value);
+                    current.has_name = true;
+                } else if (last_key == "exec") {
+                    current.entry.exec = std::move(value);
+                    current.has_exec = true;
+                } else if (last_key == "icon") {
+                    current.entry.icon = std::move(value);
+                }
+            }
+            return true;
+        }
+        bool start_array(std::size_t) {
+            if (skipped == 0 && in_array.empty()) {
+                in_array.push_back(true);
+            } else if (skipped == 0 && !in_array.back() && last_key == "items") {
+                open.back().has_items = true;
+                in_array.push_back(true);
+            } else {
+                skipped++;
+            }
+            return true;
+        }
+        bool end_array() {
+            if (skipped > 0) {
+                skipped--;
+            } else {
+                in_array.pop_back();
+            }
+            return true;
+        }
+        bool start_object(std::size_t) {
+            if (skipped == 0 && in_array.empty()) {
+                // the template must be an array
+                valid = false;
+                return false;
+            }
+            if (skipped == 0 && in_array.back()) {
+                in_array.push_back(false);
+                open.emplace_back();
+            } else {
+                skipped++;
+            }
+            return true;
+        }
+        bool end_object() {
+            if (skipped > 0) {
+                skipped--;
+                return true;
+            }
+            in_array.pop_back();
+            auto current = std::move(open.back());
+            open.pop_back();
+            if (!current.has_name || !(current.has_exec || current.has_items)) {
+                valid = false;
+                return false;
+            }
+            auto& parent = open.empty() ? entries : open.back().entry.items;
+            parent.emplace_back(std::move(current.entry));
+            return true;
+        }
+    } reader;
+    if (!ns::json::sax_parse(read_file_to_string(bar_file), &reader) || !reader.valid) {
+        throw std::runtime_error("Invalid template " + bar_file);
     }
-    return entries;
+    return std::move(reader.entries);
 }
 
 void on_button_clicked(std::string cmd) {
@@ -0,0 +1,591 @@
+/*
+ * Desktop entries for nwg-launchers: scanner, parser and categories
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <set>
+#include <tuple>
+#include <unordered_set>
+
+#include "nwg_core.h"
+
+/*
+ * Returns locations of .desktop files, most important first, as the XDG Base Directory
+ * specification defines them: $XDG_DATA_HOME, then $XDG_DATA_DIRS, with "/applications" appended.
+ * Flatpak exports and the usual system dirs follow if not listed yet.
+ * A directory reached twice, e.g. through a symlink, is only listed once.
+ * */
+std::vector<std::string> get_app_dirs() {
+    std::string homedir {};
+    if (char* home = getenv("HOME")) {
+        homedir = home;
+    }
+
+    std::vector<std::string> data_dirs;
+    char* data_home = getenv("XDG_DATA_HOME");
+    if (data_home && *data_home) {
+        data_dirs.emplace_back(data_home);
+    } else if (!homedir.empty()) {
+        data_dirs.emplace_back(homedir + "/.local/share");
+    }
+
+    char* xdg_data_dirs = getenv("XDG_DATA_DIRS");
+    std::string_view dirs = xdg_data_dirs && *xdg_data_dirs ? xdg_data_dirs : "/usr/local/share:/usr/share";
+    for (auto& dir : split_string(dirs, ":")) {
+        if (!dir.empty()) {
+            data_dirs.emplace_back(dir);
+        }
+    }
+    if (!homedir.empty()) {
+        data_dirs.emplace_back(homedir + "/.local/share/flatpak/exports/share");
+    }
+    data_dirs.emplace_back("/var/lib/flatpak/exports/share");
+    data_dirs.emplace_back("/usr/local/share");
+    data_dirs.emplace_back("/usr/share");
+
+    std::vector<std::string> result;
+    std::set<std::pair<dev_t, ino_t>> seen;
+    for (auto& dir : data_dirs) {
+        while (dir.size() > 1 && dir.back() == '/') {
+            dir.pop_back();
+        }
+        auto app_dir = dir + "/applications";
+        struct stat st;
+        if (stat(app_dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode) && seen.emplace(st.st_dev, st.st_ino).second) {
+            result.emplace_back(std::move(app_dir));
+        }
+    }
+    return result;
+}
+
+// What getdents64 fills the buffer with; not every libc declares it
+struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[256];
+};
+
+// Deep enough for any sane tree, and stops symlink loops not caught by the inode check
+static constexpr int MAX_SCAN_DEPTH = 8;
+
+/*
+ * Adds .desktop files found in the directory (and its subdirectories) to desktop_paths,
+ * unless an entry with the same desktop file ID has been found already.
+ * The ID is the path relative to the applications dir, with '/' replaced by '-'.
+ * */
+static void scan_app_dir(int dir_fd, const std::string& path, const std::string& id_prefix, int depth,
+                         std::set<std::pair<dev_t, ino_t>>& seen,
+                         std::unordered_set<std::string>& ids,
+                         std::vector<std::string>& desktop_paths) {
+    static constexpr std::string_view suffix {".desktop"};
+    alignas(linux_dirent64) char buffer[16384];
+    std::vector<std::string> subdirs;
+
+    long n;
+    while ((n = syscall(SYS_getdents64, dir_fd, buffer, sizeof(buffer))) > 0) {
+        for (long pos = 0; pos < n;) {
+            auto entry = reinterpret_cast<linux_dirent64*>(buffer + pos);
+            pos += entry->d_reclen;
+
+            std::string_view name {entry->d_name};
+            if (name == "." || name == "..") {
+                continue;
+            }
+            bool desktop_file = name.size() > suffix.size()
+                && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+
+            auto type = entry->d_type;
+            // only stat what the directory entry itself can't tell about
+            if (type == DT_UNKNOWN || (type == DT_LNK && (desktop_file || depth < MAX_SCAN_DEPTH))) {
+                struct stat st;
+                if (fstatat(dir_fd, entry->d_name, &st, 0) != 0) {
+                    continue;
+                }
+                type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+
+            if (type == DT_REG && desktop_file) {
+                auto id = id_prefix;
+                id += name;
+                if (ids.insert(std::move(id)).second) {
+                    auto& desktop_path = desktop_paths.emplace_back(path);
+                    desktop_path += '/';
+                    desktop_path += name;
+                }
+            } else if (type == DT_DIR && depth < MAX_SCAN_DEPTH) {
+                subdirs.emplace_back(name);
+            }
+        }
+    }
+
+    for (auto& subdir : subdirs) {
+        int fd = openat(dir_fd, subdir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && seen.emplace(st.st_dev, st.st_ino).second) {
+            scan_app_dir(fd, path + "/" + subdir, id_prefix + subdir + "-", depth + 1, seen, ids, desktop_paths);
+        }
+        close(fd);
+    }
+}
+
+/*
+ * Returns all .desktop files paths; of entries sharing a desktop file ID,
+ * only the one from the most important directory is returned
+ * */
+std::vector<std::string> list_entries(const std::vector<std::string>& paths) {
+    std::vector<std::string> desktop_paths;
+    std::set<std::pair<dev_t, ino_t>> seen;
+    std::unordered_set<std::string> ids;
+    for (auto& dir : paths) {
+        int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && seen.emplace(st.st_dev, st.st_ino).second) {
+            scan_app_dir(fd, dir, "", 0, seen, ids, desktop_paths);
+        }
+        close(fd);
+    }
+    return desktop_paths;
+}
+
+/*
+ * Returns the Exec= value without field codes (%f, %u and the like) and what follows them
+ * */
+static std::string_view exec_command(std::string_view exec) {
+    if (auto idx = exec.find_first_of("%"); idx != std::string_view::npos) {
+        exec = exec.substr(0, idx);
+        while (!exec.empty() && exec.back() == ' ') {
+            exec.remove_suffix(1);
+        }
+    }
+    return exec;
+}
+
+/*
+ * Parses .desktop file to DesktopEntry struct;
+ * of other groups only offsets of the actions listed by Actions= are recorded
+ * */
+DesktopEntry desktop_entry(std::string&& path, const std::string& lang, StringPool& strings) {
+    DesktopEntry entry;
+
+    // read at once, the lines are views into it
+    std::string content = read_file_to_string(path);
+
+    std::string name {};            // Name=
+    std::string name_ln {};         // localized: Name[ln]=
+    std::string loc_name = "Name[" + lang + "]=";
+
+    std::string comment {};         // Comment=
+    std::string comment_ln {};      // localized: Comment[ln]=
+    std::string loc_comment = "Comment[" + lang + "]=";
+
+    std::string generic_name {};    // GenericName=
+    std::string generic_name_ln {}; // localized: GenericName[ln]=
+    std::string loc_generic_name = "GenericName[" + lang + "]=";
+
+    std::string keywords {};        // Keywords=
+    std::string keywords_ln {};     // localized: Keywords[ln]=
+    std::string loc_keywords = "Keywords[" + lang + "]=";
+
+    std::string exec {};            // Exec=
+    std::string icon {};            // Icon=
+    std::string mime_type {};       // MimeType=
+    std::string categories {};      // Categories=
+    std::string try_exec {};        // TryExec=
+    std::string only_show_in {};    // OnlyShowIn=
+    std::string not_show_in {};     // NotShowIn=
+    std::string actions {};         // Actions=
+    std::size_t other_groups = content.size();  // where the groups following [Desktop Entry] start
+
+    std::string_view rest {content};
+    while (!rest.empty()) {
+        auto end = rest.find('\n');
+        auto view = rest.substr(0, end);
+        rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+        bool read_me = true;
+        if (view.find("[") == 0) {
+            read_me = (view.find("[Desktop Entry") != std::string_view::npos);
+            if (!read_me) {
+                other_groups = view.data() - content.data();
+                break;
+            } else {
+                continue;
+            }
+        }
+        if (read_me) {
+            // This is to resolve `Respect the NoDisplay setting in .desktop files #84`,
+            // see https://wiki.archlinux.org/index.php/desktop_entries#Hide_desktop_entries.
+            // The ~/.local/share/applications folder is going to be read first. Entries created from here won't be
+            // overwritten from e.g. /usr/share/applications, as duplicates are being skipped.
+            if (view.find("NoDisplay=true") == 0) {
+                entry.no_display = true;
+            }
+            if (view.find("Hidden=true") == 0) {
+                entry.hidden = true;
+            }
+
+            if (view.find(loc_name) == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    name_ln = view.substr(idx + 1);
+                }
+            }
+            if (view.find("Name=") == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    name = view.substr(idx + 1);
+                }
+            }
+            if (view.find("Exec=") == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    exec = exec_command(view.substr(idx + 1));
+                }
+            }
+            if (view.find("Icon=") == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    icon = view.substr(idx + 1);
+                }
+            }
+            if (view.find("Comment=") == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    comment = view.substr(idx + 1);
+                }
+            }
+            if (view.find(loc_comment) == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    comment_ln = view.substr(idx + 1);
+                }
+            }
+            if (view.find("MimeType=") == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    mime_type = view.substr(idx + 1);
+                }
+            }
+            if (view.find("GenericName=") == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    generic_name = view.substr(idx + 1);
+                }
+            }
+            if (view.find(loc_generic_name) == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    generic_name_ln = view.substr(idx + 1);
+                }
+            }
+            if (view.find("Keywords=") == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    keywords = view.substr(idx + 1);
+                }
+            }
+            if (view.find(loc_keywords) == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    keywords_ln = view.substr(idx + 1);
+                }
+            }
+            if (view.find("Categories=") == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    categories = view.substr(idx + 1);
+                }
+            }
+            if (view.find("TryExec=") == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    try_exec = view.substr(idx + 1);
+                }
+            }
+            if (view.find("OnlyShowIn=") == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    only_show_in = view.substr(idx + 1);
+                }
+            }
+            if (view.find("NotShowIn=") == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    not_show_in = view.substr(idx + 1);
+                }
+            }
+            if (view.find("Actions=") == 0) {
+                if (auto idx = view.find_first_of("="); idx != std::string_view::npos) {
+                    actions = view.substr(idx + 1);
+                }
+            }
+        }
+    }
+    entry.name = strings.store(name_ln.empty() ? name : name_ln);
+    entry.comment = strings.store(comment_ln.empty() ? comment : comment_ln);
+    entry.generic_name = strings.store(generic_name_ln.empty() ? generic_name : generic_name_ln);
+    entry.keywords = strings.store(keywords_ln.empty() ? keywords : keywords_ln);
+    // shared by many entries: terminals, wine and Steam apps, alternative .desktop files of one program
+    entry.exec = strings.intern(exec);
+    entry.icon = strings.intern(icon);
+    entry.mime_type = strings.intern(mime_type);
+    entry.categories = strings.intern(categories);
+    entry.try_exec = strings.intern(try_exec);
+    entry.only_show_in = strings.intern(only_show_in);
+    entry.not_show_in = strings.intern(not_show_in);
+
+    // Only group headers are looked at, the actions are parsed by desktop_action() on demand
+    if (!actions.empty()) {
+        static constexpr std::string_view action_header {"[Desktop Action "};
+        std::vector<std::pair<std::string_view, std::size_t>> groups;
+        for (auto pos = content.find(action_header, other_groups); pos != std::string::npos;
+             pos = content.find(action_header, pos + 1)) {
+            if (pos != 0 && content[pos - 1] != '\n') {
+                continue;
+            }
+            auto end = content.find(']', pos);
+            if (end != std::string::npos) {
+                auto id_start = pos + action_header.size();
+                groups.emplace_back(std::string_view(content).substr(id_start, end - id_start), pos);
+            }
+        }
+        for (auto id : split_string(actions, ";")) {
+            auto group = std::find_if(groups.begin(), groups.end(), [id](auto& g) { return g.first == id; });
+            if (!id.empty() && group != groups.end()) {
+                entry.actions.push_back({strings.intern(id), static_cast<std::uint32_t>(group -> second)});
+            }
+        }
+        if (!entry.actions.empty()) {
+            entry.path = strings.store(path);
+        }
+    }
+    return entry;
+}
+
+/*
+ * Parses the action group of the entry's .desktop file.
+ * Should the file have changed since it was scanned, the group is looked up by its header
+ * */
+DesktopAction desktop_action(const DesktopEntry& entry, const ActionRef& ref, const std::string& lang) {
+    DesktopAction action;
+    std::string content = read_file_to_string(std::string(entry.path));
+    std::string header = "[Desktop Action " + std::string(ref.id) + "]";
+    std::size_t start = ref.offset;
+    // the file may have been edited, or even shortened, since it was parsed
+    if (start >= content.size() || content.compare(start, header.size(), header) != 0) {
+        start = content.find(header);
+        if (start == std::string::npos) {
+            return action;
+        }
+    }
+
+    std::string name_ln {};
+    std::string loc_name = "Name[" + lang + "]=";
+    std::string_view rest = std::string_view(content).substr(start);
+    rest.remove_prefix(std::min(rest.size(), rest.find('\n')));
+    while (!rest.empty()) {
+        rest.remove_prefix(1);  // the newline
+        auto end = rest.find('\n');
+        auto view = rest.substr(0, end);
+        rest.remove_prefix(end == std::string_view::npos ? rest.size() : end);
+        if (view.find("[") == 0) {
+            break;
+        }
+        if (view.find(loc_name) == 0) {
+            name_ln = view.substr(loc_name.size());
+        } else if (view.find("Name=") == 0) {
+            action.name = view.substr(5);
+        } else if (view.find("Exec=") == 0) {
+            action.exec = exec_command(view.substr(5));
+        } else if (view.find("Icon=") == 0) {
+            action.icon = view.substr(5);
+        }
+    }
+    if (!name_ln.empty()) {
+        action.name = std::move(name_ln);
+    }
+    return action;
+}
+
+/*
+ * Returns names of the files in $PATH dirs, listed once, so that TryExec= needs no search per entry
+ * */
+std::unordered_set<std::string> path_executables() {
+    std::unordered_set<std::string> names;
+    char* path = getenv("PATH");
+    if (!path) {
+        return names;
+    }
+    alignas(linux_dirent64) char buffer[16384];
+    for (auto& dir : split_string(path, ":")) {
+        if (dir.empty()) {
+            continue;
+        }
+        int fd = open(std::string(dir).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        long n;
+        while ((n = syscall(SYS_getdents64, fd, buffer, sizeof(buffer))) > 0) {
+            for (long pos = 0; pos < n;) {
+                auto entry = reinterpret_cast<linux_dirent64*>(buffer + pos);
+                pos += entry->d_reclen;
+                if (entry->d_type != DT_DIR) {
+                    names.emplace(entry->d_name);
+                }
+            }
+        }
+        close(fd);
+    }
+    return names;
+}
+
+/*
+ * Returns the desktop names listed in $XDG_CURRENT_DESKTOP
+ * */
+std::vector<std::string_view> current_desktops() {
+    std::vector<std::string_view> desktops;
+    if (char* desktop = getenv("XDG_CURRENT_DESKTOP")) {
+        for (auto name : split_string(desktop, ":")) {
+            if (!name.empty()) {
+                desktops.push_back(name);
+            }
+        }
+    }
+    return desktops;
+}
+
+/*
+ * Tells whether OnlyShowIn= and NotShowIn= of the entry let it show in the given desktops
+ * */
+bool shown_in(const DesktopEntry& entry, const std::vector<std::string_view>& desktops) {
+    auto listed = [&desktops](std::string_view list) {
+        for (auto name : split_string(list, ";")) {
+            if (std::find(desktops.begin(), desktops.end(), name) != desktops.end()) {
+                return true;
+            }
+        }
+        return false;
+    };
+    if (!entry.only_show_in.empty() && !listed(entry.only_show_in)) {
+        return false;
+    }
+    return entry.not_show_in.empty() || !listed(entry.not_show_in);
+}
+
+/*
+ * Parses the .desktop files; returns the entries having a name and a command, sorted by name.
+ * Entries deleted by Hidden=true, not meant for the current desktop, or whose TryExec program
+ * is missing are left out. Of entries with the same name, command and mime types only the first one is kept.
+ * */
+std::vector<DesktopEntry> load_entries(std::vector<std::string>&& paths, const std::string& lang, StringPool& strings) {
+    std::vector<DesktopEntry> parsed;
+    parsed.reserve(paths.size());
+    for (auto& path : paths) {
+        parsed.push_back(desktop_entry(std::move(path), lang, strings));
+    }
+
+    auto desktops = current_desktops();
+    // $PATH is listed once, and only if some entry needs it
+    std::optional<std::unordered_set<std::string>> executables;
+    auto installed = [&executables](std::string_view program) {
+        if (program.front() == '/') {
+            return access(std::string(program).c_str(), X_OK) == 0;
+        }
+        if (!executables) {
+            executables = path_executables();
+        }
+        return executables -> count(std::string(program)) > 0;
+    };
+
+    std::vector<DesktopEntry> entries;
+    std::set<std::tuple<std::string_view, std::string_view, std::string_view>> seen;
+    for (auto& entry : parsed) {
+        if (entry.hidden || !shown_in(entry, desktops)
+            || (!entry.try_exec.empty() && !installed(entry.try_exec))) {
+            continue;
+        }
+        // Checking the mime_type field should resolve #89
+        if (!entry.name.empty() && !entry.exec.empty()
+            && seen.emplace(entry.name, entry.exec, entry.mime_type).second) {
+            entries.push_back(std::move(entry));
+        }
+    }
+    std::stable_sort(entries.begin(), entries.end(), [](auto& a, auto& b) { return a.name < b.name; });
+    return entries;
+}
+
+const std::array<Category, 12> main_categories {{
+    { "AudioVideo", "Multimedia" },
+    { "Development", "Development" },
+    { "Education", "Education" },
+    { "Game", "Games" },
+    { "Graphics", "Graphics" },
+    { "Network", "Internet" },
+    { "Office", "Office" },
+    { "Science", "Science" },
+    { "Settings", "Settings" },
+    { "System", "System" },
+    { "Utility", "Utilities" },
+    { "", "Other" }
+}};
+
+/*
+ * Returns indexes of main categories listed in the Categories= value, or the "Other" one
+ * */
+std::vector<std::size_t> entry_categories(std::string_view categories) {
+    std::vector<std::size_t> result;
+    for (auto name : split_string(categories, ";")) {
+        // Audio and Video require AudioVideo, but not every entry follows the spec
+        if (name == "Audio" || name == "Video") {
+            name = "AudioVideo";
+        }
+        for (std::size_t i = 0; i + 1 < main_categories.size(); i++) {
+            if (name == main_categories[i].id
+                && std::find(result.begin(), result.end(), i) == result.end()) {
+                result.push_back(i);
+            }
+        }
+    }
+    if (result.empty()) {
+        result.push_back(main_categories.size() - 1);
+    }
+    return result;
+}
+
+/*
+ * Finds the category whose id or label starts with the name, case insensitive;
+ * returns main_categories.size() if there is none
+ * */
+std::size_t find_category(std::string_view name) {
+    auto starts_with = [name](std::string_view str) {
+        return str.size() >= name.size() && std::equal(name.begin(), name.end(), str.begin(), [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+        });
+    };
+    if (!name.empty()) {
+        for (std::size_t i = 0; i < main_categories.size(); i++) {
+            if (starts_with(main_categories[i].id) || starts_with(main_categories[i].label)) {
+                return i;
+            }
+        }
+    }
+    return main_categories.size();
+}
+
+/*
+ * Adds the entry to the search index and to the lists of its categories; returns its id
+ * */
+std::uint32_t add_to_corpus(SearchCorpus& corpus, const DesktopEntry& entry) {
+    auto id = corpus.index.add({ entry.name, entry.generic_name, entry.keywords,
+                                 entry.categories, entry.exec, entry.comment });
+    for (auto c : entry_categories(entry.categories)) {
+        corpus.category_ids[c].push_back(id);
+    }
+    return id;
+}
@@ -88,15 +88,14 @@ AppBox::AppBox() {
     this -> set_always_show_image(true);
 }
 
-AppBox::AppBox(Glib::ustring name, Glib::ustring exec, Glib::ustring comment) {
-    this -> name = name;
-    if (name.length() > 25) {
-        name = name.substr(0, 22) + "...";
+AppBox::AppBox(std::string_view name, std::string_view exec, std::string_view comment)
+ : name(name), exec(exec), comment(comment) {
+    Glib::ustring label(name.begin(), name.end());
+    if (label.length() > 25) {
+        label = label.substr(0, 22) + "...";
     }
-    this -> exec = std::move(exec);
-    this -> comment = std::move(comment);
     this -> set_always_show_image(true);
-    this -> set_label(name);
+    this -> set_label(label);
 }
 
 AppBox::~AppBox() {
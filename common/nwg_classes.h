@@ -12,6 +12,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <gtkmm.h>
@@ -48,16 +49,20 @@ class CommonWindow : public Gtk::Window {
         bool _SUPPORTS_ALPHA;
 };
 
+/*
+ * The text is not owned by the box, but by the caller's entries (see StringPool)
+ * and must outlive it
+ * */
 class AppBox : public Gtk::Button {
     public:
         AppBox();
-        AppBox(Glib::ustring, Glib::ustring, Glib::ustring);
+        AppBox(std::string_view, std::string_view, std::string_view);
         AppBox(AppBox&&) = default;
         AppBox(const AppBox&) = delete;
 
-        Glib::ustring name;
-        Glib::ustring exec;
-        Glib::ustring comment;
+        std::string_view name;
+        std::string_view exec;
+        std::string_view comment;
 
         virtual ~AppBox();
 };
@@ -72,15 +77,6 @@ struct Geometry {
     int height;
 };
 
-struct DesktopEntry {
-    std::string name;
-    std::string exec;
-    std::string icon;
-    std::string comment;
-    std::string mime_type;
-    bool no_display {false};
-};
-
 struct RGBA {
     double red;
     double green;
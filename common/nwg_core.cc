@@ -0,0 +1,384 @@
+/*
+ * GTK-free core of nwg-launchers: files, json and favourites
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <glib.h>
+
+#include "nwg_core.h"
+
+CacheEntry::CacheEntry(std::string exec, int clicks): exec(std::move(exec)), clicks(clicks) { }
+
+/*
+ * Returns file content as a string, empty if the file can not be read
+ * */
+std::string read_file_to_string(const std::string& filename) {
+    std::string content;
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return content;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        // a regular file is read at once into a buffer of its size, up to that size
+        content.resize(st.st_size);
+        std::size_t size = 0;
+        while (size < content.size()) {
+            auto n = pread(fd, content.data() + size, content.size() - size, size);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            size += n;
+        }
+        close(fd);
+        content.resize(size);
+        return content;
+    }
+    // files reporting no size, as in /proc, are read up to their end
+    content = read_fd_to_string(fd);
+    close(fd);
+    return content;
+}
+
+/*
+ * Returns everything read from a pipe or a file descriptor up to its end
+ * */
+std::string read_fd_to_string(int fd) {
+    std::string content;
+    std::size_t size = 0;
+    content.resize(65536);
+    while (true) {
+        auto n = read(fd, content.data() + size, content.size() - size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        size += n;
+        if (size == content.size()) {
+            content.resize(content.size() * 2);
+        }
+    }
+    content.resize(size);
+    // the content may be kept for long, so more than a little growth slack is given back
+    if (content.capacity() - size > size / 8) {
+        content.shrink_to_fit();
+    }
+    return content;
+}
+
+/*
+ * Saves a string to a file: writes a temporary file next to it and renames it over,
+ * so that the file is never left truncated or half-written
+ * */
+void save_string_to_file(const std::string& s, const std::string& filename) {
+    std::string tmp_name = filename + ".XXXXXX";
+    int fd = mkostemp(tmp_name.data(), O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "ERROR: Failed saving " << filename << ": " << std::strerror(errno) << '\n';
+        return;
+    }
+    const char* data = s.data();
+    std::size_t size = s.size();
+    bool ok = true;
+    while (size > 0) {
+        auto n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ok = false;
+            break;
+        }
+        data += n;
+        size -= n;
+    }
+    ok = ok && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmp_name.c_str(), filename.c_str()) < 0) {
+        std::cerr << "ERROR: Failed saving " << filename << ": " << std::strerror(errno) << '\n';
+        unlink(tmp_name.c_str());
+    }
+}
+
+/*
+ * Splits string into vector of strings by delimiter
+ * */
+std::vector<std::string_view> split_string(std::string_view str, std::string_view delimiter) {
+    std::vector<std::string_view> result;
+    std::size_t current, previous = 0;
+    current = str.find_first_of(delimiter);
+    while (current != std::string_view::npos) {
+        result.emplace_back(str.substr(previous, current - previous));
+        previous = current + 1;
+        current = str.find_first_of(delimiter, previous);
+    }
+    result.emplace_back(str.substr(previous, current - previous));
+
+    return result;
+}
+
+/*
+ * Splits string by delimiter and takes the last piece
+ * */
+std::string_view take_last_by(std::string_view str, std::string_view delimiter) {
+    auto pos = str.find_last_of(delimiter);
+    if (pos != std::string_view::npos) {
+        return str.substr(pos + 1);
+    }
+    return str;
+}
+
+/*
+ * Converts json string into a json object
+ * */
+ns::json string_to_json(const std::string& jsonString) {
+    return ns::json::parse(jsonString);
+}
+
+/*
+ * Saves json into file
+ * */
+void save_json(const ns::json& json_obj, const std::string& filename) {
+    save_string_to_file(json_obj.dump(2) + '\n', filename);
+}
+
+/*
+ * Returns resident set size of the process in kB, or 0 if unknown
+ * */
+long get_rss_kb() {
+    long pages = 0;
+    long resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    if (statm >> pages >> resident) {
+        return resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+    return 0;
+}
+
+/*
+ * Returns peak resident set size of the process in kB, or 0 if unknown
+ * */
+long get_peak_rss_kb() {
+    std::ifstream status("/proc/self/status");
+    for (std::string line; std::getline(status, line);) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::strtol(line.c_str() + 6, nullptr, 10);
+        }
+    }
+    return 0;
+}
+
+/*
+ * Returns exec -> clicks out of the cache file, a json object; throws if it can not be parsed
+ * */
+std::map<std::string, int> get_cache(const std::string& cache_file) {
+    struct CacheReader : JsonSaxReader {
+        std::map<std::string, int> cache;
+        std::string exec;
+        int depth = 0;
+
+        bool key(std::string& key) {
+            exec = std::move(key);
+            return true;
+        }
+        bool number_integer(ns::json::number_integer_t clicks) {
+            if (depth == 1) {
+                cache[std::move(exec)] = clicks;
+            }
+            return true;
+        }
+        bool number_unsigned(ns::json::number_unsigned_t clicks) {
+            return number_integer(clicks);
+        }
+        bool start_object(std::size_t) {
+            depth++;
+            return true;
+        }
+        bool end_object() {
+            depth--;
+            return true;
+        }
+        bool start_array(std::size_t) {
+            // only a flat object is expected
+            return depth > 0;
+        }
+    } reader;
+    if (!ns::json::sax_parse(read_file_to_string(cache_file), &reader)) {
+        throw std::runtime_error("Failed parsing " + cache_file);
+    }
+    return std::move(reader.cache);
+}
+
+/*
+ * Returns n cache items sorted by clicks; n should be the number of grid columns
+ * */
+std::vector<CacheEntry> get_favourites(const std::map<std::string, int>& cache, int number) {
+    std::vector<CacheEntry> sorted_cache {}; // not yet sorted
+    for (auto& [exec, clicks] : cache) {
+        sorted_cache.emplace_back(exec, clicks);
+    }
+    // actually sort by the number of clicks
+    sort(sorted_cache.begin(), sorted_cache.end(), [](const CacheEntry& lhs, const CacheEntry& rhs) {
+        return lhs.clicks > rhs.clicks;
+    });
+    // Trim to the number of columns, as we need just 1 row of favourites
+    auto from = sorted_cache.begin() + number;
+    auto to = sorted_cache.end();
+    sorted_cache.erase(from, to);
+    return sorted_cache;
+}
+
+/*
+ * Takes over newline-separated text as the lines, split as std::getline would split it.
+ * UTF-8 is validated in one pass over the whole text; should that fail, invalid lines are repaired
+ * */
+void LineArena::assign(std::string&& new_text) {
+    clear();
+    if (new_text.empty()) {
+        return;
+    }
+    text = std::move(new_text);
+    if (text.back() != '\n') {
+        text += '\n';
+    }
+    const char* data = text.data();
+    const char* end = data + text.size();
+    offsets.reserve(std::count(data, end, '\n') + 1);
+    for (auto p = data; p < end;) {
+        p = static_cast<const char*>(std::memchr(p, '\n', end - p)) + 1;
+        offsets.push_back(p - data);
+    }
+    if (!g_utf8_validate(text.data(), text.size(), nullptr)) {
+        LineArena lines = std::move(*this);
+        clear();
+        reserve(lines.size(), lines.text.size());
+        for (std::size_t i = 0; i < lines.size(); i++) {
+            auto line = lines[i];
+            if (g_utf8_validate(line.data(), line.size(), nullptr)) {
+                add(line);
+            } else {
+                gchar* valid = g_utf8_make_valid(line.data(), line.size());
+                add(valid);
+                g_free(valid);
+            }
+        }
+    }
+}
+
+void LineArena::add(std::string_view line) {
+    text.append(line);
+    text += '\n';
+    offsets.push_back(text.size());
+}
+
+/*
+ * Appends the case folded line
+ * */
+void LineArena::add_folded(std::string_view line) {
+    fold_case(line, text);
+    text += '\n';
+    offsets.push_back(text.size());
+}
+
+void LineArena::reserve(std::size_t lines, std::size_t bytes) {
+    offsets.reserve(lines + 1);
+    text.reserve(bytes);
+}
+
+/*
+ * Reorders the lines: the i-th one becomes the line order[i] was
+ * */
+void LineArena::permute(const std::vector<std::size_t>& order) {
+    LineArena lines;
+    lines.reserve(order.size(), text.size());
+    for (auto i : order) {
+        lines.add((*this)[i]);
+    }
+    *this = std::move(lines);
+}
+
+void LineArena::clear() {
+    text.clear();
+    offsets.assign(1, 0);
+}
+
+/*
+ * Indexes the lines by their first byte; returns false, indexing nothing, if they are not in byte order
+ * */
+bool PrefixIndex::build(const LineArena& lines) {
+    for (std::size_t i = 1; i < lines.size(); i++) {
+        if (lines[i] < lines[i - 1]) {
+            return false;
+        }
+    }
+    std::size_t line = 0;
+    for (std::size_t c = 0; c < 256; c++) {
+        while (line < lines.size()
+               && (lines[line].empty() || static_cast<unsigned char>(lines[line].front()) < c)) {
+            line++;
+        }
+        first_char[c] = line;
+    }
+    first_char[256] = lines.size();
+    return true;
+}
+
+/*
+ * Returns the range of the indexed lines starting with the non-empty prefix
+ * */
+std::pair<std::size_t, std::size_t> PrefixIndex::range(const LineArena& lines, std::string_view prefix) const {
+    auto c = static_cast<unsigned char>(prefix.front());
+    // first line in [lo, hi) for which less is false
+    auto partition = [&lines](std::size_t lo, std::size_t hi, auto less) {
+        while (lo < hi) {
+            auto mid = lo + (hi - lo) / 2;
+            if (less(lines[mid])) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    };
+    auto start = partition(first_char[c], first_char[c + 1], [prefix](std::string_view line) {
+        return line < prefix;
+    });
+    auto end = partition(start, first_char[c + 1], [prefix](std::string_view line) {
+        return line.substr(0, prefix.size()) == prefix;
+    });
+    return {start, end};
+}
+
+Matcher::Matcher(std::string_view phrase, bool case_sensitive):
+    phrase(case_sensitive ? std::string(phrase) : fold_case(phrase)) { }
+
+/*
+ * Tells whether and where the line contains the phrase
+ * */
+Matcher::Match Matcher::match(std::string_view line) const {
+    auto pos = find_text(line, phrase);
+    if (pos == std::string_view::npos) {
+        return NONE;
+    }
+    return pos == 0 ? PREFIX : SUBSTRING;
+}
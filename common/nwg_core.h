@@ -0,0 +1,271 @@
+/*
+ * GTK-free core of nwg-launchers: entry model, scanner, parser, search corpus and matcher
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "search_index.h"
+#include "string_pool.h"
+#include "text_search.h"
+#include "thread_pool.h"
+
+namespace ns = nlohmann;
+
+/*
+ * Base of SAX handlers for ns::json::sax_parse: accepts and ignores everything,
+ * a handler hides the callbacks it needs. Stops at errors, so that sax_parse returns false.
+ * */
+struct JsonSaxReader {
+    bool null() { return true; }
+    bool boolean(bool) { return true; }
+    bool number_integer(ns::json::number_integer_t) { return true; }
+    bool number_unsigned(ns::json::number_unsigned_t) { return true; }
+    bool number_float(ns::json::number_float_t, const ns::json::string_t&) { return true; }
+    bool string(ns::json::string_t&) { return true; }
+    template <typename Binary>
+    bool binary(Binary&) { return true; }
+    bool start_object(std::size_t) { return true; }
+    bool key(ns::json::string_t&) { return true; }
+    bool end_object() { return true; }
+    bool start_array(std::size_t) { return true; }
+    bool end_array() { return true; }
+    template <typename Exception>
+    bool parse_error(std::size_t, const std::string&, const Exception&) { return false; }
+};
+
+/*
+ * [Desktop Action <id>] group of a .desktop file, parsed only when needed
+ * */
+struct ActionRef {
+    std::string_view id;
+    std::uint32_t offset;               // of the group header in the file
+};
+
+struct DesktopAction {
+    std::string name;
+    std::string exec;
+    std::string icon;
+};
+
+/*
+ * Views into a StringPool
+ * */
+struct DesktopEntry {
+    std::string_view name;
+    std::string_view exec;
+    std::string_view icon;
+    std::string_view comment;
+    std::string_view mime_type;
+    std::string_view generic_name;
+    std::string_view keywords;
+    std::string_view categories;
+    std::string_view try_exec;          // shown only if this program is installed
+    std::string_view only_show_in;      // desktops the entry is meant for, ';'-separated
+    std::string_view not_show_in;       // desktops the entry is not meant for
+    std::string_view path;              // of the .desktop file, if it has actions
+    std::vector<ActionRef> actions {};  // as ordered by Actions=
+    bool no_display {false};
+    bool hidden {false};                // Hidden=true: deleted, as if there was no such file
+};
+
+/*
+ * Freedesktop main category: the Categories= value and the tab label
+ * */
+struct Category {
+    std::string_view id;
+    std::string_view label;
+};
+
+/*
+ * Main categories, the last one collects entries declaring none of them
+ * */
+extern const std::array<Category, 12> main_categories;
+
+/*
+ * Searchable entries; not modified once published, so that a search thread may read them
+ * */
+struct SearchCorpus {
+    SearchIndex index {};
+    std::array<std::vector<std::uint32_t>, main_categories.size()> category_ids {}; // ascending
+};
+
+struct CacheEntry {
+    std::string exec;
+    int clicks;
+    CacheEntry(std::string, int);
+};
+
+/*
+ * Lines kept one after another in a single buffer, each one followed by '\n',
+ * so that a line costs its bytes, the separator and an offset
+ * */
+class LineArena {
+    public:
+        void assign(std::string&& text);
+        void add(std::string_view);
+        void add_folded(std::string_view);
+        void reserve(std::size_t lines, std::size_t bytes);
+        void permute(const std::vector<std::size_t>& order);
+        void clear();
+
+        std::size_t size() const { return offsets.size() - 1; }
+        bool empty() const { return size() == 0; }
+        std::size_t bytes() const { return text.capacity() + offsets.capacity() * sizeof(std::size_t); }
+        std::string_view operator[](std::size_t i) const {
+            return {text.data() + offsets[i], offsets[i + 1] - offsets[i] - 1};
+        }
+
+    private:
+        std::string text {};
+        std::vector<std::size_t> offsets {0};   // where each line starts, the last one where the next would
+};
+
+/*
+ * Where the lines of a sorted LineArena starting with each byte begin, so that the lines
+ * having a prefix are found by a binary search within those starting with its first byte
+ * */
+class PrefixIndex {
+    public:
+        bool build(const LineArena& lines);
+        std::pair<std::size_t, std::size_t> range(const LineArena& lines, std::string_view prefix) const;
+
+    private:
+        std::array<std::size_t, 257> first_char {};
+};
+
+// Shorter lists are matched on the calling thread, nor are chunks made shorter than this
+constexpr std::size_t PARALLEL_FIND_MIN = 65536;
+constexpr std::size_t PARALLEL_CHUNK_MIN = 16384;
+
+/*
+ * Finds the search phrase in lines, as nwgdmenu does: anywhere in the line.
+ * Case insensitive matching expects lines folded already (see LineArena::add_folded)
+ * */
+class Matcher {
+    public:
+        enum Match { NONE, PREFIX, SUBSTRING };
+
+        Matcher(std::string_view phrase, bool case_sensitive);
+
+        Match match(std::string_view line) const;
+
+        /*
+         * Appends up to max ids out of order whose lines match: prefix matches first,
+         * substring matches fill the rest; both keep the given order
+         * */
+        template <typename LineAt>
+        void find(const std::vector<std::size_t>& order, LineAt&& line_at,
+                  std::size_t max, std::vector<std::size_t>& results) const {
+            std::vector<std::size_t> substring_matches;
+            auto limit = results.size() + max;
+            for (auto i : order) {
+                if (results.size() >= limit) {
+                    break;
+                }
+                auto found = match(line_at(i));
+                if (found == PREFIX) {
+                    results.push_back(i);
+                } else if (found == SUBSTRING && substring_matches.size() < max) {
+                    substring_matches.push_back(i);
+                }
+            }
+            for (auto i : substring_matches) {
+                if (results.size() >= limit) {
+                    break;
+                }
+                results.push_back(i);
+            }
+        }
+
+        /*
+         * find, with chunks of a long order matched on the pool. Each chunk keeps its first max
+         * prefix and substring matches; joined in chunk order, they give what find would
+         * */
+        template <typename LineAt>
+        void find(ThreadPool& pool, const std::vector<std::size_t>& order, LineAt&& line_at,
+                  std::size_t max, std::vector<std::size_t>& results) const {
+            if (order.size() < PARALLEL_FIND_MIN || pool.size() == 1) {
+                find(order, line_at, max, results);
+                return;
+            }
+            auto chunks = std::min(pool.size() * 4, order.size() / PARALLEL_CHUNK_MIN);
+            std::vector<std::vector<std::size_t>> prefix_matches(chunks);
+            std::vector<std::vector<std::size_t>> substring_matches(chunks);
+            pool.run(chunks, [&](std::size_t chunk) {
+                auto& prefix = prefix_matches[chunk];
+                auto& substring = substring_matches[chunk];
+                auto end = order.begin() + order.size() * (chunk + 1) / chunks;
+                for (auto it = order.begin() + order.size() * chunk / chunks; it != end; ++it) {
+                    if (prefix.size() >= max) {
+                        break;
+                    }
+                    auto found = match(line_at(*it));
+                    if (found == PREFIX) {
+                        prefix.push_back(*it);
+                    } else if (found == SUBSTRING && substring.size() < max) {
+                        substring.push_back(*it);
+                    }
+                }
+            });
+            auto limit = results.size() + max;
+            for (auto* matches : {&prefix_matches, &substring_matches}) {
+                for (auto& chunk : *matches) {
+                    for (auto i : chunk) {
+                        if (results.size() >= limit) {
+                            return;
+                        }
+                        results.push_back(i);
+                    }
+                }
+            }
+        }
+
+    private:
+        std::string phrase;                     // folded unless case sensitive
+};
+
+/*
+ * Function declarations
+ * */
+std::string read_file_to_string(const std::string&);
+std::string read_fd_to_string(int);
+void save_string_to_file(const std::string&, const std::string&);
+std::vector<std::string_view> split_string(std::string_view, std::string_view);
+std::string_view take_last_by(std::string_view, std::string_view);
+
+ns::json string_to_json(const std::string&);
+void save_json(const ns::json&, const std::string&);
+
+long get_rss_kb(void);
+long get_peak_rss_kb(void);
+
+std::vector<std::string> get_app_dirs(void);
+std::vector<std::string> list_entries(const std::vector<std::string>&);
+DesktopEntry desktop_entry(std::string&&, const std::string&, StringPool&);
+std::vector<DesktopEntry> load_entries(std::vector<std::string>&&, const std::string&, StringPool&);
+DesktopAction desktop_action(const DesktopEntry&, const ActionRef&, const std::string&);
+std::unordered_set<std::string> path_executables(void);
+std::vector<std::string_view> current_desktops(void);
+bool shown_in(const DesktopEntry&, const std::vector<std::string_view>&);
+std::vector<std::size_t> entry_categories(std::string_view);
+std::size_t find_category(std::string_view);
+std::uint32_t add_to_corpus(SearchCorpus&, const DesktopEntry&);
+
+std::map<std::string, int> get_cache(const std::string&);
+std::vector<CacheEntry> get_favourites(const std::map<std::string, int>&, int);
@@ -11,11 +11,22 @@
 
 #include <stdlib.h>
 #include <unistd.h>
-#include <stdlib.h>
-#include <signal.h>
-
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include <array>
+#include <cerrno>
+#include <clocale>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <optional>
+#include <set>
 
 #include "nwgconfig.h"
 #include "nwg_tools.h"
@@ -23,8 +34,8 @@
 // extern variables from nwg_tools.h
 int image_size = 72;
 
-// stores the name of the pid_file, for use in atexit
-static std::string pid_file{};
+// listening socket of the single running instance, see ensure_single_instance
+static int instance_fd = -1;
 
 /*
  * Returns config dir
@@ -90,28 +101,108 @@ std::string detect_wm() {
 }
 
 /*
- * Returns x, y, width, hight of focused display
+ * Pulls the rect of the focused output out of `swaymsg -t get_outputs`,
+ * skipping the rest (modes and all), returns false if not found
+ * */
+static bool focused_output_rect(const std::string& outputs, Geometry& geo) {
+    struct OutputsReader : JsonSaxReader {
+        int depth = 0;          // of objects and arrays: 1 the outputs array, 2 an output, 3 its rect
+        bool in_rect = false;
+        bool focused = false;
+        Geometry rect {0, 0, 0, 0};
+        std::string last_key;
+        std::optional<Geometry> found;
+
+        bool key(std::string& key) {
+            last_key = std::move(key);
+            return true;
+        }
+        bool boolean(bool value) {
+            if (depth == 2 && last_key == "focused") {
+                focused = value;
+            }
+            return true;
+        }
+        bool number_integer(ns::json::number_integer_t value) {
+            if (in_rect && depth == 3) {
+                if (last_key == "x") {
+                    rect.x = value;
+                } else if (last_key == "y") {
+                    rect.y = value;
+                } else if (last_key == "width") {
+                    rect.width = value;
+                } else if (last_key == "height") {
+                    rect.height = value;
+                }
+            }
+            return true;
+        }
+        bool number_unsigned(ns::json::number_unsigned_t value) {
+            return number_integer(value);
+        }
+        bool start_object(std::size_t) {
+            depth++;
+            in_rect = depth == 3 && last_key == "rect";
+            return true;
+        }
+        bool end_object() {
+            if (depth == 3) {
+                in_rect = false;
+            } else if (depth == 2) {
+                if (focused) {
+                    found = rect;
+                    return false;   // done, stop parsing
+                }
+                rect = {0, 0, 0, 0};
+            }
+            depth--;
+            return true;
+        }
+        bool start_array(std::size_t) {
+            depth++;
+            return true;
+        }
+        bool end_array() {
+            depth--;
+            return true;
+        }
+    } reader;
+    ns::json::sax_parse(outputs, &reader);
+    if (reader.found) {
+        geo = *reader.found;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Returns x, y, width, hight of the focused output, as told by the WM; only sway is asked.
+ * Safe to call off the main thread
  * */
-Geometry display_geometry(const std::string& wm, Glib::RefPtr<Gdk::Display> display, Glib::RefPtr<Gdk::Window> window) {
+std::optional<Geometry> focused_output_geometry(const std::string& wm) {
     Geometry geo = {0, 0, 0, 0};
     if (wm == "sway") {
         try {
             auto jsonString = get_output("swaymsg -t get_outputs");
-            auto jsonObj = string_to_json(jsonString);
-            for (auto&& entry : jsonObj) {
-                if (entry.at("focused")) {
-                    auto&& rect = entry.at("rect");
-                    geo.x = rect.at("x");
-                    geo.y = rect.at("y");
-                    geo.width = rect.at("width");
-                    geo.height = rect.at("height");
-                    break;
-                }
+            if (focused_output_rect(jsonString, geo)) {
+                return geo;
             }
-            return geo;
         }
         catch (...) { }
     }
+    return std::nullopt;
+}
+
+/*
+ * Returns x, y, width, hight of focused display: the focused output,
+ * if known (see focused_output_geometry), or the monitor of the window
+ * */
+Geometry display_geometry(const std::optional<Geometry>& focused_output,
+                          Glib::RefPtr<Gdk::Display> display, Glib::RefPtr<Gdk::Window> window) {
+    if (focused_output) {
+        return *focused_output;
+    }
+    Geometry geo = {0, 0, 0, 0};
 
     // it's going to fail until the window is actually open
     int retry = 0;
@@ -134,24 +225,82 @@ Geometry display_geometry(const std::string& wm, Glib::RefPtr<Gdk::Display> disp
     return geo;
 }
 
+// Pixbufs by image size, then by icon name or file path; entries sharing an icon share the pixbuf
+static std::map<int, std::map<std::string, Glib::RefPtr<Gdk::Pixbuf>, std::less<>>> pixbuf_cache;
+
 /*
- * Returns Gtk::Image out of the icon name of file path
+ * Returns the pixbuf rasterized once out of the missing icon image, empty if not installed
  * */
-Gtk::Image* app_image(const Gtk::IconTheme& icon_theme, const std::string& icon) {
+static Glib::RefPtr<Gdk::Pixbuf> missing_icon_pixbuf(int size) {
+    static const std::string missing_icon {DATA_DIR_STR "/nwgbar/icon-missing.svg"};
+    auto& pixbufs = pixbuf_cache[size];
+    if (auto it = pixbufs.find(missing_icon); it != pixbufs.end()) {
+        return it->second;
+    }
     Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+    try {
+        pixbuf = Gdk::Pixbuf::create_from_file(missing_icon, size, size, true);
+    } catch (const Glib::Error& error) {
+        std::cerr << "ERROR: " << error.what() << '\n';
+    }
+    pixbufs.emplace(missing_icon, pixbuf);
+    return pixbuf;
+}
+
+/*
+ * Returns Gtk::Image out of the icon name of file path
+ * */
+Gtk::Image* app_image(const Gtk::IconTheme& icon_theme, std::string_view icon) {
+    auto& pixbufs = pixbuf_cache[image_size];
+    if (auto it = pixbufs.find(icon); it != pixbufs.end()) {
+        return Gtk::manage(new Gtk::Image(it->second));
+    }
 
+    std::string icon_name {icon};
+    Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+    // check before loading, missing icons are common and exceptions are not cheap
     try {
-        if (icon.find_first_of("/") == std::string::npos) {
-            pixbuf = icon_theme.load_icon(icon, image_size, Gtk::ICON_LOOKUP_FORCE_SIZE);
-        } else {
-            pixbuf = Gdk::Pixbuf::create_from_file(icon, image_size, image_size, true);
+        if (icon.find_first_of("/") == std::string_view::npos) {
+            if (!icon.empty() && icon_theme.has_icon(icon_name)) {
+                pixbuf = icon_theme.load_icon(icon_name, image_size, Gtk::ICON_LOOKUP_FORCE_SIZE);
+            }
+        } else if (Glib::file_test(icon_name, Glib::FILE_TEST_IS_REGULAR)) {
+            pixbuf = Gdk::Pixbuf::create_from_file(icon_name, image_size, image_size, true);
         }
     } catch (...) {
-        pixbuf = Gdk::Pixbuf::create_from_file(DATA_DIR_STR "/nwgbar/icon-missing.svg", image_size, image_size, true);
+        // listed, but broken
     }
-    auto image = Gtk::manage(new Gtk::Image(pixbuf));
+    if (!pixbuf) {
+        pixbuf = missing_icon_pixbuf(image_size);
+    }
+    pixbufs.emplace(std::move(icon_name), pixbuf);
+
+    return Gtk::manage(new Gtk::Image(pixbuf));
+}
+
+/*
+ * Returns the number of cached pixbufs and the bytes of their pixels; a shared one counts once
+ * */
+std::pair<std::size_t, std::size_t> pixbuf_cache_usage() {
+    std::set<const GdkPixbuf*> seen;
+    std::size_t bytes = 0;
+    for (auto& [size, pixbufs] : pixbuf_cache) {
+        for (auto& [icon, pixbuf] : pixbufs) {
+            if (pixbuf && seen.insert(pixbuf -> gobj()).second) {
+                bytes += gdk_pixbuf_get_byte_length(pixbuf -> gobj());
+            }
+        }
+    }
+    return { seen.size(), bytes };
+}
 
-    return image;
+/*
+ * Sets the locale up from the environment, as gtk_init would. Startup tasks may use it
+ * on worker threads by the time GTK initializes, so GTK must not set it once again.
+ * */
+void init_locale() {
+    std::setlocale(LC_ALL, "");
+    gtk_disable_setlocale();
 }
 
 /*
@@ -174,72 +323,6 @@ std::string get_locale() {
     return l;
 }
 
-/*
- * Returns file content as a string
- * */
-std::string read_file_to_string(const std::string& filename) {
-    std::ifstream input(filename);
-    std::stringstream sstr;
-
-    while(input >> sstr.rdbuf());
-
-    return sstr.str();
-}
-
-/*
- * Saves a string to a file
- * */
-void save_string_to_file(const std::string& s, const std::string& filename) {
-    std::ofstream file(filename);
-    file << s;
-}
-
-/*
- * Splits string into vector of strings by delimiter
- * */
-std::vector<std::string_view> split_string(std::string_view str, std::string_view delimiter) {
-    std::vector<std::string_view> result;
-    std::size_t current, previous = 0;
-    current = str.find_first_of(delimiter);
-    while (current != std::string_view::npos) {
-        result.emplace_back(str.substr(previous, current - previous));
-        previous = current + 1;
-        current = str.find_first_of(delimiter, previous);
-    }
-    result.emplace_back(str.substr(previous, current - previous));
-
-    return result;
-}
-
-/*
- * Splits string by delimiter and takes the last piece
- * */
-std::string_view take_last_by(std::string_view str, std::string_view delimiter) {
-    auto pos = str.find_last_of(delimiter);
-    if (pos != std::string_view::npos) {
-        return str.substr(pos + 1);
-    }
-    return str;
-}
-
-/*
- * Converts json string into a json object
- * */
-ns::json string_to_json(const std::string& jsonString) {
-    ns::json jsonObj;
-    std::stringstream(jsonString) >> jsonObj;
-
-    return jsonObj;
-}
-
-/*
- * Saves json into file
- * */
-void save_json(const ns::json& json_obj, const std::string& filename) {
-    std::ofstream o(filename);
-    o << std::setw(2) << json_obj << std::endl;
-}
-
 /*
  * Sets RGBA background according to hex strings
 * */
@@ -278,87 +361,158 @@ void set_background(const std::string_view string) {
  * */
 std::string get_output(const std::string& cmd) {
     const char *command = cmd.c_str();
-    std::array<char, 128> buffer;
+    std::array<char, 65536> buffer;
     std::string result;
     std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(command, "r"), pclose);
     if (!pipe) {
         throw std::runtime_error("popen() failed!");
     }
-    while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-        result += buffer.data();
+    std::size_t n;
+    while ((n = fread(buffer.data(), 1, buffer.size(), pipe.get())) > 0) {
+        result.append(buffer.data(), n);
     }
     return result;
 }
 
+/*
+ * Returns the user's runtime directory
+ * */
+std::string get_runtime_dir() {
+    char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir) {
+        return runtime_dir;
+    }
+    return "/var/run/user/" + std::to_string(getuid());
+}
 
 /*
- * Remove pid_file created by create_pid_file_or_kill_pid.
- * This function will be run before exiting.
+ * Returns the socket path of cmd's running instance: in the runtime dir, which only the user
+ * may enter, so that neither can other users reach the instance, nor take its name
  * */
-static void clean_pid_file(void) {
-    unlink(pid_file.c_str());
+static std::string instance_socket_path(const std::string& cmd) {
+    return get_runtime_dir() + "/" + cmd + ".instance.sock";
 }
 
 /*
- * Signal handler to exit normally with SIGTERM
+ * Fills addr with the socket path, returns false if it does not fit
  * */
-static void exit_normal(int sig) {
-    if (sig == SIGTERM) {
-        std::cerr << "Received SIGTERM, exiting...\n";
+static bool instance_address(const std::string& path, sockaddr_un& addr) {
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "ERROR: Socket path too long: " << path << '\n';
+        return false;
     }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
 
-    std::exit(1);
+/*
+ * Asks the running instance to close, retries for a while
+ * in case it has taken the lock, but has not bound its socket yet
+ * */
+static bool send_instance_message(const std::string& cmd) {
+    constexpr std::string_view message {"close"};
+    sockaddr_un addr {};
+    if (!instance_address(instance_socket_path(cmd), addr)) {
+        return false;
+    }
+    for (int retry = 0; retry < 50; retry++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return false;
+        }
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+            bool sent = send(fd, message.data(), message.size(), MSG_NOSIGNAL)
+                == static_cast<ssize_t>(message.size());
+            close(fd);
+            return sent;
+        }
+        close(fd);
+        usleep(10000);
+    }
+    return false;
 }
 
 /*
- * Creates PID file for the new instance,
- * or kills the other cmd instance.
+ * Makes sure a single instance of cmd runs.
  *
- * If it creates a PID file, it also sets up a signal handler to exit
- * normally if it receives SIGTERM; and registers an atexit() action
- * to run when exiting normally.
+ * The first instance takes an flock on $XDG_RUNTIME_DIR/<cmd>.lock and listens
+ * on $XDG_RUNTIME_DIR/<cmd>.instance.sock. The kernel releases the lock when the process
+ * exits, however it exits; a socket file left behind is replaced by the next instance.
+ * Later invocations fail to take the lock, ask the running instance to close
+ * and exit.
  *
  * This allows for behavior where using the shortcut to open one
  * of the launchers closes the currently running one.
  * */
-void create_pid_file_or_kill_pid(std::string cmd) {
-    std::string myuid = std::to_string(getuid());
-
-    char *runtime_dir_tmp = getenv("XDG_RUNTIME_DIR");
-    std::string runtime_dir;
-    if (runtime_dir_tmp) {
-        runtime_dir = runtime_dir_tmp;
-    } else {
-        runtime_dir = "/var/run/user/" + myuid;
+void ensure_single_instance(const std::string& cmd) {
+    auto lock_file = get_runtime_dir() + "/" + cmd + ".lock";
+    // kept open for the lifetime of the process, to hold the lock
+    int lock_fd = open(lock_file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lock_fd < 0) {
+        std::cerr << "ERROR: Failed opening " << lock_file << ": " << std::strerror(errno) << '\n';
+        return;
+    }
+    if (flock(lock_fd, LOCK_EX | LOCK_NB) < 0) {
+        close(lock_fd);
+        if (errno != EWOULDBLOCK) {
+            std::cerr << "ERROR: Failed locking " << lock_file << ": " << std::strerror(errno) << '\n';
+            return;
+        }
+        // found running instance
+        std::exit(send_instance_message(cmd) ? 0 : 1);
     }
 
-    pid_file = runtime_dir + "/" + cmd + ".pid";
-
-    auto pid_read = std::ifstream(pid_file);
-    // set to not throw exceptions
-    pid_read.exceptions(std::ifstream::goodbit);
-    if (pid_read.is_open()) {
-        // opening file worked - file exists
-        pid_t saved_pid;
-        pid_read >> saved_pid;
-
-        if (saved_pid > 0 && kill(saved_pid, 0) == 0) {
-            // found running instance
-            // PID file will be deleted by process's atexit routine
-            int rv = kill(saved_pid, SIGTERM);
-
-            // exit with status dependent on kill success
-            std::exit(rv == 0 ? 0 : 1);
+    auto socket_path = instance_socket_path(cmd);
+    sockaddr_un addr {};
+    if (!instance_address(socket_path, addr)) {
+        return;
+    }
+    // the lock is ours, so the socket is stale
+    unlink(socket_path.c_str());
+    instance_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (instance_fd < 0
+        || bind(instance_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+        || listen(instance_fd, 4) < 0) {
+        std::cerr << "ERROR: Failed creating instance socket: " << std::strerror(errno) << '\n';
+        if (instance_fd >= 0) {
+            close(instance_fd);
+            instance_fd = -1;
         }
     }
+}
 
-    std::string mypid = std::to_string(getpid());
-    save_string_to_file(mypid, pid_file);
+/*
+ * Calls handler when a later invocation (see ensure_single_instance) asks to close,
+ * once the main loop runs
+ * */
+void watch_instance_messages(std::function<void()> handler) {
+    if (instance_fd < 0) {
+        return;
+    }
+    Glib::signal_io().connect([handler = std::move(handler)](Glib::IOCondition condition) {
+        (void) condition; // suppress warning
 
-    // register function to clean pid file
-    atexit(clean_pid_file);
-    // register signal handler for SIGTERM
-    struct sigaction act {};
-    act.sa_handler = exit_normal;
-    sigaction(SIGTERM, &act, nullptr);
+        int fd = accept4(instance_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            return true;
+        }
+        // only the user's own invocations may close the instance, should the runtime dir be shared
+        ucred peer {};
+        socklen_t peer_len = sizeof(peer);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &peer_len) < 0 || peer.uid != getuid()) {
+            close(fd);
+            return true;
+        }
+        // the sender writes right after connecting, don't let a stuck one block the loop
+        timeval timeout {0, 100000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        std::array<char, 16> buffer;
+        auto n = read(fd, buffer.data(), buffer.size());
+        close(fd);
+        if (n > 0) {
+            handler();
+        }
+        return true;
+    }, instance_fd, Glib::IO_IN);
 }
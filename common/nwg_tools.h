@@ -11,19 +11,19 @@
 
 #pragma once
 
+#include <functional>
 #include <iostream>
 #include <iomanip>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 #include <gtkmm.h>
 
-#include <nlohmann/json.hpp>
-
 #include "nwg_classes.h"
-
-namespace ns = nlohmann;
+#include "nwg_core.h"
 
 extern int image_size; // button image size in pixels
 
@@ -31,20 +31,18 @@ std::string get_config_dir(std::string);
 
 std::string detect_wm(void);
 
+void init_locale(void);
 std::string get_locale(void);
 
-std::string read_file_to_string(const std::string&);
-void save_string_to_file(const std::string&, const std::string&);
-std::vector<std::string_view> split_string(std::string_view, std::string_view);
-std::string_view take_last_by(std::string_view, std::string_view);
-
-ns::json string_to_json(const std::string&);
-void save_json(const ns::json&, const std::string&);
 void set_background(const std::string_view);
 
 std::string get_output(const std::string&);
 
-Gtk::Image* app_image(const Gtk::IconTheme&, const std::string&);
-Geometry display_geometry(const std::string&, Glib::RefPtr<Gdk::Display>, Glib::RefPtr<Gdk::Window>);
+Gtk::Image* app_image(const Gtk::IconTheme&, std::string_view);
+std::pair<std::size_t, std::size_t> pixbuf_cache_usage(void);
+std::optional<Geometry> focused_output_geometry(const std::string&);
+Geometry display_geometry(const std::optional<Geometry>&, Glib::RefPtr<Gdk::Display>, Glib::RefPtr<Gdk::Window>);
 
-void create_pid_file_or_kill_pid(std::string);
+std::string get_runtime_dir(void);
+void ensure_single_instance(const std::string&);
+void watch_instance_messages(std::function<void()>);
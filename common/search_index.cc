@@ -0,0 +1,145 @@
+/*
+ * Search index for nwg-launchers
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+
+#include "search_index.h"
+#include "text_search.h"
+
+// Step size verifying all the candidates at once
+static constexpr std::size_t ALL_CANDIDATES = static_cast<std::size_t>(-1);
+
+// Separates fields of a document, so that neither trigrams nor words match across them
+static constexpr char FIELD_SEPARATOR = '\x1f';
+
+static std::uint32_t trigram(std::string_view str, std::size_t pos) {
+    return static_cast<unsigned char>(str[pos]) << 16
+        | static_cast<unsigned char>(str[pos + 1]) << 8
+        | static_cast<unsigned char>(str[pos + 2]);
+}
+
+/*
+ * Adds a document, returns its id; ids are consecutive, starting from 0
+ * */
+std::uint32_t SearchIndex::add(std::initializer_list<std::string_view> fields) {
+    auto id = static_cast<std::uint32_t>(offsets.size());
+    auto start = text.size();
+    offsets.push_back(start);
+    for (auto field : fields) {
+        if (!field.empty()) {
+            fold_case(field, text);
+            text += FIELD_SEPARATOR;
+        }
+    }
+
+    std::vector<std::uint32_t> trigrams;
+    std::string_view doc {text.data() + start, text.size() - start};
+    for (std::size_t i = 0; i + 3 <= doc.size(); i++) {
+        if (doc.substr(i, 3).find(FIELD_SEPARATOR) == std::string_view::npos) {
+            trigrams.push_back(trigram(doc, i));
+        }
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    // documents are added in id order, so the posting lists stay sorted
+    for (auto t : trigrams) {
+        postings[t].push_back(id);
+    }
+    return id;
+}
+
+std::string_view SearchIndex::document(std::uint32_t id) const {
+    auto start = offsets[id];
+    auto end = id + 1 < offsets.size() ? offsets[id + 1] : text.size();
+    return {text.data() + start, end - start};
+}
+
+/*
+ * Returns ids of documents matching all words of the query, ascending
+ * */
+std::vector<std::uint32_t> SearchIndex::search(std::string_view query,
+                                               const std::vector<std::uint32_t>* within) const {
+    Query running {*this, query, within};
+    running.step(ALL_CANDIDATES);
+    return std::move(running.result);
+}
+
+/*
+ * Splits the query into words and narrows the candidates down to documents having all their trigrams
+ * */
+SearchIndex::Query::Query(const SearchIndex& index, std::string_view query,
+                          const std::vector<std::uint32_t>* within)
+ : index(index), phrase(fold_case(query)) {
+    std::string_view rest {phrase};
+    while (!rest.empty()) {
+        auto start = rest.find_first_not_of(" \t");
+        if (start == std::string_view::npos) {
+            break;
+        }
+        rest.remove_prefix(start);
+        auto end = std::min(rest.find_first_of(" \t"), rest.size());
+        words.push_back(rest.substr(0, end));
+        rest.remove_prefix(end);
+    }
+
+    // posting lists of every trigram of every long enough word
+    std::vector<const std::vector<std::uint32_t>*> lists;
+    for (auto word : words) {
+        for (std::size_t i = 0; i + 3 <= word.size(); i++) {
+            auto it = index.postings.find(trigram(word, i));
+            if (it == index.postings.end()) {
+                return;
+            }
+            lists.push_back(&it->second);
+        }
+    }
+    if (within) {
+        lists.push_back(within);
+    }
+
+    if (lists.empty()) {
+        candidates.resize(index.size());
+        std::iota(candidates.begin(), candidates.end(), 0);
+    } else {
+        // intersect the shortest lists first, to keep the intermediate results small
+        std::sort(lists.begin(), lists.end(), [](auto a, auto b) {
+            return a->size() < b->size() || (a->size() == b->size() && std::less<>()(a, b));
+        });
+        lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+        candidates = *lists.front();
+        std::vector<std::uint32_t> narrowed;
+        for (std::size_t i = 1; i < lists.size() && !candidates.empty(); i++) {
+            narrowed.clear();
+            std::set_intersection(candidates.begin(), candidates.end(),
+                                  lists[i]->begin(), lists[i]->end(),
+                                  std::back_inserter(narrowed));
+            candidates.swap(narrowed);
+        }
+    }
+}
+
+/*
+ * Verifies up to count more candidates, returns true when all of them are done
+ * */
+bool SearchIndex::Query::step(std::size_t count) {
+    // having all the trigrams does not make the word a substring yet
+    auto end = next + std::min(count, candidates.size() - next);
+    for (; next < end; next++) {
+        auto doc = index.document(candidates[next]);
+        bool found = std::all_of(words.begin(), words.end(), [doc](auto word) {
+            return find_text(doc, word) != std::string_view::npos;
+        });
+        if (found) {
+            result.push_back(candidates[next]);
+        }
+    }
+    return next == candidates.size();
+}
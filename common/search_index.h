@@ -0,0 +1,63 @@
+/*
+ * Search index for nwg-launchers
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Trigram inverted index over documents made of several text fields.
+ * Text is casefolded; a query matches documents containing each of its
+ * whitespace separated words. Words of three or more bytes are looked up
+ * in the posting lists, so only documents having all their trigrams are checked.
+ * */
+class SearchIndex {
+    public:
+        class Query;
+
+        std::uint32_t add(std::initializer_list<std::string_view> fields);
+        std::vector<std::uint32_t> search(std::string_view query,
+                                          const std::vector<std::uint32_t>* within = nullptr) const;
+
+        std::size_t size() const { return offsets.size(); }
+
+    private:
+        std::string_view document(std::uint32_t id) const;
+
+        std::string text {};                        // casefolded documents, one after another
+        std::vector<std::size_t> offsets {};        // where each document starts in text
+        std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> postings {}; // trigram -> document ids
+};
+
+/*
+ * A search in progress: candidates are verified a slice at a time,
+ * so that the caller can yield in between
+ * */
+class SearchIndex::Query {
+    public:
+        /* index, query, ascending ids to search within (all if null) */
+        Query(const SearchIndex&, std::string_view, const std::vector<std::uint32_t>* within = nullptr);
+        Query(const Query&) = delete;
+
+        bool step(std::size_t count);
+
+        std::vector<std::uint32_t> result {};       // matching ids so far, ascending
+
+    private:
+        const SearchIndex& index;
+        std::string phrase;
+        std::vector<std::string_view> words {};     // views into phrase
+        std::vector<std::uint32_t> candidates {};
+        std::size_t next {0};                       // first candidate not verified yet
+};
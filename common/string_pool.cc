@@ -0,0 +1,49 @@
+/*
+ * String storage for nwg-launchers
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <cstring>
+
+#include "string_pool.h"
+
+// Most entries' text fits in the first couple of chunks
+static constexpr std::size_t INITIAL_CHUNK = 64 * 1024;
+
+StringPool::StringPool(): arena(INITIAL_CHUNK) { }
+
+/*
+ * Copies the string into the arena
+ * */
+std::string_view StringPool::store(std::string_view str) {
+    if (str.empty()) {
+        return {};
+    }
+    auto data = static_cast<char*>(arena.allocate(str.size(), 1));
+    std::memcpy(data, str.data(), str.size());
+    stored += str.size();
+    return {data, str.size()};
+}
+
+/*
+ * Returns the stored copy of the string, storing it on first use
+ * */
+std::string_view StringPool::intern(std::string_view str) {
+    if (auto it = index.find(str); it != index.end()) {
+        return *it;
+    }
+    auto view = store(str);
+    index.insert(view);
+    return view;
+}
+
+/*
+ * Frees the interning index; stored strings stay valid, later intern() calls start over
+ * */
+void StringPool::drop_index() {
+    std::unordered_set<std::string_view>().swap(index);
+}
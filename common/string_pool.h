@@ -0,0 +1,37 @@
+/*
+ * String storage for nwg-launchers
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <memory_resource>
+#include <string_view>
+#include <unordered_set>
+
+/*
+ * Stores strings once, in a monotonic arena, and hands out views to them.
+ * The views stay valid for the lifetime of the pool.
+ * Values repeated across entries (icon names, mime types, commands) are interned.
+ * */
+class StringPool {
+    public:
+        StringPool();
+        StringPool(const StringPool&) = delete;
+        StringPool& operator=(const StringPool&) = delete;
+
+        std::string_view store(std::string_view);
+        std::string_view intern(std::string_view);
+        void drop_index();
+
+        std::size_t bytes() const { return stored; }
+
+    private:
+        std::pmr::monotonic_buffer_resource arena;
+        std::unordered_set<std::string_view> index {};  // interned strings, only needed while filling the pool
+        std::size_t stored {0};
+};
@@ -0,0 +1,137 @@
+/*
+ * Startup task graph for nwg-launchers
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <algorithm>
+#include <iomanip>
+
+#include "task_graph.h"
+
+TaskGraph::TaskGraph(): created(Clock::now()) {}
+
+TaskGraph::~TaskGraph() {
+    // let the remaining tasks finish, they may refer to the caller's data
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+/*
+ * Adds a task running after the given ones; must be called before run()
+ * */
+TaskGraph::Task TaskGraph::add(std::string name, std::function<void()> work, std::vector<Task> after) {
+    nodes.push_back({std::move(name), std::move(work), std::move(after)});
+    return nodes.size() - 1;
+}
+
+/*
+ * Starts the worker threads, one per task at most
+ * */
+void TaskGraph::run() {
+    auto count = std::max(1u, std::thread::hardware_concurrency());
+    count = std::min<std::size_t>(count, nodes.size());
+    for (unsigned i = 0; i < count; i++) {
+        workers.emplace_back(&TaskGraph::work, this, i + 1);
+    }
+}
+
+bool TaskGraph::ready(const Node& node) const {
+    return !node.started && std::all_of(node.after.begin(), node.after.end(), [this](auto task) {
+        return nodes[task].done;
+    });
+}
+
+void TaskGraph::work(int thread) {
+    std::unique_lock lock {mutex};
+    while (true) {
+        auto next = nodes.end();
+        changed.wait(lock, [this, &next] {
+            next = std::find_if(nodes.begin(), nodes.end(), [this](auto& node) { return ready(node); });
+            return next != nodes.end()
+                || std::all_of(nodes.begin(), nodes.end(), [](auto& node) { return node.started; });
+        });
+        if (next == nodes.end()) {
+            return;
+        }
+        auto& node = *next;
+        node.started = true;
+        // a failed dependency fails the task as well
+        for (auto task : node.after) {
+            if (nodes[task].error) {
+                node.error = nodes[task].error;
+            }
+        }
+        auto start = Clock::now();
+        if (!node.error) {
+            lock.unlock();
+            std::exception_ptr error;
+            try {
+                node.work();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            lock.lock();
+            node.error = error;
+        }
+        node.done = true;
+        records.push_back({node.name, thread, start, Clock::now()});
+        changed.notify_all();
+    }
+}
+
+/*
+ * Blocks until the task is done, rethrows its exception if it failed
+ * */
+void TaskGraph::wait(Task task) {
+    std::unique_lock lock {mutex};
+    changed.wait(lock, [this, task] { return nodes[task].done; });
+    if (nodes[task].error) {
+        std::rethrow_exception(nodes[task].error);
+    }
+}
+
+TaskGraph::Phase::Phase(TaskGraph& graph, std::string name)
+ : graph(graph), name(std::move(name)), start(Clock::now()) {}
+
+TaskGraph::Phase::~Phase() {
+    std::lock_guard lock {graph.mutex};
+    graph.records.push_back({std::move(name), 0, start, Clock::now()});
+}
+
+/*
+ * Prints how long the recorded tasks and phases took and how much of it overlapped;
+ * detailed: one line per task or phase as well
+ * */
+void TaskGraph::print_trace(std::ostream& out, bool detailed) const {
+    std::lock_guard lock {mutex};
+    auto flags = out.flags();
+    auto precision = out.precision();
+    auto ms = [this](Clock::time_point time) {
+        return std::chrono::duration<double, std::milli>(time - created).count();
+    };
+    auto sorted = records;
+    std::sort(sorted.begin(), sorted.end(), [](auto& a, auto& b) { return a.start < b.start; });
+
+    double busy = 0;
+    double end = 0;
+    for (auto& record : sorted) {
+        busy += ms(record.end) - ms(record.start);
+        end = std::max(end, ms(record.end));
+        if (detailed) {
+            out << "  " << std::left << std::setw(10) << record.name
+                << (record.thread == 0 ? "main     " : "worker " + std::to_string(record.thread) + " ")
+                << std::right << std::fixed << std::setprecision(1)
+                << std::setw(7) << ms(record.start) << " - " << std::setw(7) << ms(record.end) << " ms\n";
+        }
+    }
+    out << std::fixed << std::setprecision(1)
+        << "Startup: " << busy << " ms of work in " << end << " ms, "
+        << std::max(0.0, busy - end) << " ms overlapped\n";
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,81 @@
+/*
+ * Startup task graph for nwg-launchers
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Runs independent startup phases on worker threads, while the main thread
+ * goes on with GTK; the main thread joins a task only where it needs its data.
+ * Tasks run once their dependencies are done, they must not touch GTK.
+ * Main thread phases may be recorded too, so that the trace shows the overlap.
+ * */
+class TaskGraph {
+    public:
+        using Task = std::size_t;
+        using Clock = std::chrono::steady_clock;
+
+        /*
+         * Records a main thread phase from construction to destruction
+         * */
+        class Phase {
+            public:
+                Phase(TaskGraph&, std::string);
+                Phase(const Phase&) = delete;
+                ~Phase();
+            private:
+                TaskGraph& graph;
+                std::string name;
+                Clock::time_point start;
+        };
+
+        TaskGraph();
+        TaskGraph(const TaskGraph&) = delete;
+        ~TaskGraph();
+
+        Task add(std::string, std::function<void()>, std::vector<Task> after = {});
+        void run();
+        void wait(Task);
+        void print_trace(std::ostream&, bool detailed) const;
+
+    private:
+        struct Node {
+            std::string name;
+            std::function<void()> work;
+            std::vector<Task> after;
+            bool started = false;
+            bool done = false;
+            std::exception_ptr error {};
+        };
+        struct Record {
+            std::string name;
+            int thread;                         // 0 for the main thread
+            Clock::time_point start;
+            Clock::time_point end;
+        };
+
+        bool ready(const Node&) const;
+        void work(int);
+
+        Clock::time_point created;
+        std::vector<Node> nodes {};
+        std::vector<Record> records {};
+        mutable std::mutex mutex;               // guards nodes' state and records
+        std::condition_variable changed;        // a task got done
+        std::vector<std::thread> workers {};
+};
@@ -0,0 +1,151 @@
+/*
+ * Substring search for nwg-launchers
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <cstdint>
+#include <cstring>
+
+#include <glib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NWG_X86_SIMD
+#endif
+
+#include "text_search.h"
+
+using FindFunction = std::size_t (*)(std::string_view, std::string_view);
+
+static std::size_t find_scalar(std::string_view haystack, std::string_view needle) {
+    return haystack.find(needle);
+}
+
+#ifdef NWG_X86_SIMD
+/*
+ * Compares blocks of the haystack with the first and the last byte of the needle,
+ * only the positions where both of them match are compared in full.
+ * Called with 2 <= needle.size() <= haystack.size().
+ * */
+__attribute__((target("sse2")))
+static std::size_t find_sse2(std::string_view haystack, std::string_view needle) {
+    auto k = needle.size();
+    auto n = haystack.size();
+    auto data = haystack.data();
+    auto first = _mm_set1_epi8(needle.front());
+    auto last = _mm_set1_epi8(needle.back());
+    std::size_t i = 0;
+    for (; i + k - 1 + 16 <= n; i += 16) {
+        auto block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        auto block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + k - 1));
+        auto eq = _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last));
+        auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(eq));
+        while (mask) {
+            auto bit = __builtin_ctz(mask);
+            if (std::memcmp(data + i + bit + 1, needle.data() + 1, k - 2) == 0) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    // fewer than 16 positions left
+    auto pos = haystack.substr(i).find(needle);
+    return pos == std::string_view::npos ? pos : i + pos;
+}
+
+__attribute__((target("avx2")))
+static std::size_t find_avx2(std::string_view haystack, std::string_view needle) {
+    auto k = needle.size();
+    auto n = haystack.size();
+    auto data = haystack.data();
+    auto first = _mm256_set1_epi8(needle.front());
+    auto last = _mm256_set1_epi8(needle.back());
+    std::size_t i = 0;
+    for (; i + k - 1 + 32 <= n; i += 32) {
+        auto block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        auto block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + k - 1));
+        auto eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last));
+        auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(eq));
+        while (mask) {
+            auto bit = __builtin_ctz(mask);
+            if (std::memcmp(data + i + bit + 1, needle.data() + 1, k - 2) == 0) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    // fewer than 32 positions left
+    auto rest = haystack.substr(i);
+    auto pos = rest.size() >= k + 15 ? find_sse2(rest, needle) : rest.find(needle);
+    return pos == std::string_view::npos ? pos : i + pos;
+}
+#endif
+
+static FindFunction select_find() {
+#ifdef NWG_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return find_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return find_sse2;
+    }
+#endif
+    return find_scalar;
+}
+
+/*
+ * find_text for haystacks having at least FIND_BLOCKS_MIN positions to check
+ * */
+std::size_t find_text_blocks(std::string_view haystack, std::string_view needle) {
+    static const FindFunction find = select_find();
+    return find(haystack, needle);
+}
+
+/*
+ * Tells whether the text is 7-bit ASCII, a word at a time
+ * */
+bool is_ascii(std::string_view str) {
+    constexpr std::uint64_t HIGH_BITS = 0x8080808080808080;
+    std::size_t i = 0;
+    std::uint64_t any = 0;
+    for (; i + 8 <= str.size(); i += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, str.data() + i, sizeof(word));
+        any |= word;
+    }
+    for (; i < str.size(); i++) {
+        any |= static_cast<unsigned char>(str[i]);
+    }
+    return (any & HIGH_BITS) == 0;
+}
+
+/*
+ * Appends the casefolded text to out: ASCII is lowered in place, other text goes through GLib
+ * */
+void fold_case(std::string_view str, std::string& out) {
+    if (is_ascii(str)) {
+        auto start = out.size();
+        out.append(str);
+        for (auto i = start; i < out.size(); i++) {
+            auto c = out[i];
+            if (c >= 'A' && c <= 'Z') {
+                out[i] = c + ('a' - 'A');
+            }
+        }
+        return;
+    }
+    gchar* folded = g_utf8_casefold(str.data(), str.size());
+    out += folded;
+    g_free(folded);
+}
+
+std::string fold_case(std::string_view str) {
+    std::string result;
+    fold_case(str, result);
+    return result;
+}
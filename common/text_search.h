@@ -0,0 +1,37 @@
+/*
+ * Substring search for nwg-launchers
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/*
+ * Case insensitive search is done by folding both sides once and then searching bytes:
+ * fold_case lowers ASCII text with a byte loop and casefolds anything else,
+ * find_text looks for the needle with SSE2 or AVX2, as the CPU supports.
+ * */
+std::size_t find_text_blocks(std::string_view haystack, std::string_view needle);
+bool is_ascii(std::string_view);
+void fold_case(std::string_view, std::string& out);
+std::string fold_case(std::string_view);
+
+// Below this many positions to check, memchr and memcmp of std::string_view::find win
+constexpr std::size_t FIND_BLOCKS_MIN = 32;
+
+/*
+ * Returns the position of the first occurrence of needle in haystack, or npos
+ * */
+inline std::size_t find_text(std::string_view haystack, std::string_view needle) {
+    if (needle.size() < 2 || haystack.size() < needle.size() + FIND_BLOCKS_MIN) {
+        // most commands and names are short
+        return haystack.find(needle);
+    }
+    return find_text_blocks(haystack, needle);
+}
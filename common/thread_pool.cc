@@ -0,0 +1,109 @@
+/*
+ * Thread pool for nwg-launchers
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <algorithm>
+
+#include "thread_pool.h"
+
+/*
+ * One thread per hardware thread, or the given number; the calling thread counts as one
+ * */
+ThreadPool::ThreadPool(): ThreadPool(std::thread::hardware_concurrency()) {}
+
+ThreadPool::ThreadPool(std::size_t threads): threads(std::max<std::size_t>(threads, 1)) {}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock {mutex};
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+/*
+ * Runs job(0) ... job(jobs - 1) and returns once all of them are done;
+ * rethrows the first exception a job threw
+ * */
+void ThreadPool::run(std::size_t jobs, const Job& job) {
+    {
+        std::lock_guard lock {mutex};
+        if (workers.empty()) {
+            for (std::size_t i = 1; i < size(); i++) {
+                workers.emplace_back(&ThreadPool::work, this);
+            }
+        }
+        this -> job = &job;
+        this -> jobs = jobs;
+        next = 0;
+        finished = 0;
+        error = nullptr;
+    }
+    wake.notify_all();
+
+    std::size_t index;
+    while (take(index)) {
+        try {
+            job(index);
+            finish(nullptr);
+        } catch (...) {
+            finish(std::current_exception());
+        }
+    }
+
+    std::unique_lock lock {mutex};
+    done.wait(lock, [this] { return finished == this -> jobs; });
+    this -> job = nullptr;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+bool ThreadPool::take(std::size_t& index) {
+    std::lock_guard lock {mutex};
+    if (!job || next == jobs) {
+        return false;
+    }
+    index = next++;
+    return true;
+}
+
+void ThreadPool::finish(std::exception_ptr failure) {
+    std::lock_guard lock {mutex};
+    if (failure && !error) {
+        error = failure;
+    }
+    if (++finished == jobs) {
+        done.notify_all();
+    }
+}
+
+void ThreadPool::work() {
+    while (true) {
+        const Job* current;
+        std::size_t index;
+        {
+            std::unique_lock lock {mutex};
+            wake.wait(lock, [this] { return stopping || (job && next < jobs); });
+            if (stopping) {
+                return;
+            }
+            current = job;
+            index = next++;
+        }
+        try {
+            (*current)(index);
+            finish(nullptr);
+        } catch (...) {
+            finish(std::current_exception());
+        }
+    }
+}
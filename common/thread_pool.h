@@ -0,0 +1,52 @@
+/*
+ * Thread pool for nwg-launchers
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Runs batches of numbered jobs on threads started on the first batch and kept
+ * for the next ones; the calling thread takes jobs too. Batches are run one at a time.
+ * */
+class ThreadPool {
+    public:
+        using Job = std::function<void(std::size_t)>;
+
+        ThreadPool();
+        explicit ThreadPool(std::size_t threads);
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ~ThreadPool();
+
+        std::size_t size() const { return threads; }
+        void run(std::size_t jobs, const Job&);
+
+    private:
+        void work();
+        bool take(std::size_t& index);
+        void finish(std::exception_ptr);
+
+        std::size_t threads;                    // the calling one included
+        std::vector<std::thread> workers {};
+        std::mutex mutex;                       // guards everything below
+        std::condition_variable wake;           // a batch started, or the pool is stopping
+        std::condition_variable done;           // the last job of the batch finished
+        const Job* job {nullptr};               // the batch running, if any
+        std::size_t jobs {0};
+        std::size_t next {0};                   // first job not taken yet
+        std::size_t finished {0};
+        std::exception_ptr error {};            // first failure of the batch
+        bool stopping {false};
+};
@@ -13,7 +13,7 @@
 
 #include "nwg_tools.h"
 #include "nwg_classes.h"
-#include "on_event.h"
+#include "task_graph.h"
 #include "dmenu.h"
 
 #define ROWS_DEFAULT 20
@@ -28,7 +28,8 @@ std::string wm {""};                        // detected or forced window manager
 std::string settings_file {""};
 
 int rows = ROWS_DEFAULT;                    // number of menu items to display
-std::vector<Glib::ustring> all_commands {};
+LineArena all_commands {};
+DMenuServer* dmenu_server = nullptr;        // set in the resident mode only
 
 bool dmenu_run = false;
 bool show_searchbox = true;
@@ -48,7 +49,11 @@ Options:\n\
 -o <opacity>     background opacity (0.0 - 1.0, default 0.3)\n\
 -b <background>  background colour in RRGGBB or RRGGBBAA format (RRGGBBAA alpha overrides <opacity>)\n\
 -wm <wmname>     window manager name (if can not be detected)\n\
--run             ignore stdin, always build from commands in $PATH\n\n\
+-run             ignore stdin, always build from commands in $PATH\n\
+-sort            sort stdin input case insensitive\n\
+-list            show all matches in a scrollable list of <rows> height instead of the menu\n\
+-daemon          stay resident, serving menus requested with -client\n\
+-client          request the menu from a running daemon, pass stdin over to it\n\n\
 Hotkeys:\n\
 Delete        clear search box\n\
 Insert        switch case sensitivity\n";
@@ -64,8 +69,6 @@ int main(int argc, char *argv[]) {
         case_sensitive = false;
     }
 
-    create_pid_file_or_kill_pid("nwgdmenu");
-
     InputParser input(argc, argv);
     if (input.cmdOptionExists("-h")){
         std::cout << HELP_MESSAGE;
@@ -79,11 +82,29 @@ int main(int argc, char *argv[]) {
         dmenu_run = true;
     }
 
-    // Otherwise let's build from stdin input
-    if (!dmenu_run) {
-        all_commands = {};
-        for (std::string line; std::getline(std::cin, line);) {
-            all_commands.emplace_back(std::move(line));
+    if (input.cmdOptionExists("-client")) {
+        int fd = connect_to_daemon(get_socket_path());
+        if (fd >= 0) {
+            return run_client(fd, input.cmdOptionExists("-sort"));
+        }
+        std::cerr << "nwgdmenu daemon not running, opening the menu directly\n";
+    }
+
+    bool resident = input.cmdOptionExists("-daemon");
+    ensure_single_instance(resident ? "nwgdmenu-daemon" : "nwgdmenu");
+    // The daemon gets its input from clients, and lists $PATH commands once for the run mode ones
+    if (resident) {
+        dmenu_run = true;
+    }
+
+    bool sort = input.cmdOptionExists("-sort");
+
+    bool list_view = false;
+    if (input.cmdOptionExists("-list")) {
+        if (resident) {
+            std::cerr << "The list view is not available in the daemon mode, -list ignored\n";
+        } else {
+            list_view = true;
         }
     }
 
@@ -151,60 +172,82 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    std::string config_dir = get_config_dir("nwgdmenu");
-    if (!fs::is_directory(config_dir)) {
-        std::cout << "Config dir not found, creating...\n";
-        fs::create_directories(config_dir);
+    /* get current WM name if not forced */
+    if (wm.empty()) {
+        wm = detect_wm();
     }
 
+    std::string config_dir = get_config_dir("nwgdmenu");
     // default and custom style sheet
     std::string default_css_file = config_dir + "/style.css";
     // css file to be used
     std::string css_file = config_dir + "/" + custom_css_file;
-    // copy default file if not found
-    if (!fs::exists(default_css_file)) {
-        try {
-            fs::copy_file(DATA_DIR_STR "/nwgdmenu/style.css", default_css_file, fs::copy_options::overwrite_existing);
-        } catch (...) {
-            std::cerr << "Failed copying default style.css\n";
-        }
-    }
 
-    /* get current WM name if not forced */
-    if (wm.empty()) {
-        wm = detect_wm();
-    }
+    std::optional<Geometry> sway_output;
+
+    /* Phases below run on worker threads while GTK initializes, data is joined where needed;
+     * the data is declared above (or global), so that it outlives the tasks.
+     * Collation keys used for sorting depend on the locale, so it's set up first */
+    init_locale();
+    TaskGraph tasks;
 
-    if (dmenu_run) {
-        /* get a list of paths to all commands from all application dirs */
-        std::vector<std::string> commands = list_commands();
-        std::cout << commands.size() << " commands found\n";
-
-        /* Create a vector of commands (w/o path) */
-        all_commands = {};
-        for (auto&& command : commands) {
-            auto cmd = take_last_by(command, "/");
-            if (cmd.find(".") != 0 && cmd.size() != 1) {
-                all_commands.emplace_back(cmd.data(), cmd.size());
+    auto config_task = tasks.add("config", [&] {
+        if (!fs::is_directory(config_dir)) {
+            std::cout << "Config dir not found, creating...\n";
+            fs::create_directories(config_dir);
+        }
+        // copy default file if not found
+        if (!fs::exists(default_css_file)) {
+            try {
+                fs::copy_file(DATA_DIR_STR "/nwgdmenu/style.css", default_css_file, fs::copy_options::overwrite_existing);
+            } catch (...) {
+                std::cerr << "Failed copying default style.css\n";
             }
         }
+    });
+
+    auto commands_task = tasks.add("commands", [&] {
+        if (dmenu_run) {
+            /* get a list of paths to all commands from all application dirs */
+            std::vector<std::string> commands = list_commands();
+            std::cout << commands.size() << " commands found\n";
+
+            /* Create a list of commands (w/o path) */
+            all_commands.clear();
+            all_commands.reserve(commands.size(), commands.size() * 16);
+            for (auto&& command : commands) {
+                auto cmd = take_last_by(command, "/");
+                if (cmd.find(".") != 0 && cmd.size() != 1) {
+                    all_commands.add(cmd);
+                }
+            }
 
-        /* Sort case insensitive */
-        std::sort(all_commands.begin(), all_commands.end(), [](auto& a, auto& b) {
-            return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [](auto a, auto b) {
-                return std::tolower(a) < std::tolower(b);
-            });
-        });
-    }
+            /* Sort case insensitive */
+            sort_commands(all_commands);
+        } else {
+            // Otherwise let's build from stdin input, read at once and split in place
+            all_commands.assign(read_fd_to_string(STDIN_FILENO));
+            if (sort) {
+                sort_commands(all_commands);
+            }
+        }
+    });
+
+    /* turn off borders, enable floating on sway; get the focused output meanwhile */
+    auto sway_task = tasks.add("sway", [&] {
+        if (wm == "sway") {
+            auto* cmd = "swaymsg -q for_window [title=\"~nwgdmenu*\"] floating enable";
+            std::system(cmd);
+            cmd = "swaymsg -q for_window [title=\"~nwgdmenu*\"] border none";
+            std::system(cmd);
+        }
+        sway_output = focused_output_geometry(wm);
+    });
 
-    /* turn off borders, enable floating on sway */
-    if (wm == "sway") {
-        auto* cmd = "swaymsg -q for_window [title=\"~nwgdmenu*\"] floating enable";
-        std::system(cmd);
-        cmd = "swaymsg -q for_window [title=\"~nwgdmenu*\"] border none";
-        std::system(cmd);
-    }
+    tasks.run();
 
+    std::optional<TaskGraph::Phase> gtk_phase;
+    gtk_phase.emplace(tasks, "gtk");
     Gtk::Main kit(argc, argv);
 
     auto provider = Gtk::CssProvider::create();
@@ -216,6 +259,7 @@ int main(int argc, char *argv[]) {
     }
     Gtk::StyleContext::add_provider_for_screen(screen, provider, GTK_STYLE_PROVIDER_PRIORITY_USER);
 
+    tasks.wait(config_task);
     if (std::filesystem::is_regular_file(css_file)) {
         provider->load_from_path(css_file);
         std::cout << "Using " << css_file << '\n';
@@ -224,18 +268,35 @@ int main(int argc, char *argv[]) {
         std::cout << "Using " << default_css_file << '\n';
     }
 
+    // the window rules must be in place before the window shows up
+    tasks.wait(sway_task);
     MainWindow window;
     // For openbox and similar we'll need the window x, y coordinates
     window.show();
 
-    DMenu menu;
-    Anchor anchor(&menu);
-    window.anchor = &anchor;
+    // DMenu and DMenuList fill themselves with all_commands
+    tasks.wait(commands_task);
+    std::optional<DMenu> menu;
+    std::optional<Anchor> anchor;
+    std::optional<DMenuList> list;
+    if (list_view) {
+        list.emplace();
+    } else {
+        menu.emplace();
+        anchor.emplace(&*menu);
+        window.anchor = &*anchor;
+    }
+
+    window.signal_button_press_event().connect([](GdkEventButton* event) {
+        (void) event; // suppress warning
 
-    window.signal_button_press_event().connect(sigc::ptr_fun(&on_window_clicked));
+        dmenu_quit();
+        return true;
+    });
 
     /* Detect focused display geometry: {x, y, width, height} */
-    auto geometry = display_geometry(wm, display, window.get_window());
+    auto geometry = display_geometry(sway_output, display, window.get_window());
+    gtk_phase.reset();
     std::cout << "Focused display: " << geometry.x << ", " << geometry.y << ", " << geometry.width << ", "
     << geometry.height << '\n';
 
@@ -278,33 +339,15 @@ int main(int argc, char *argv[]) {
         //~ window.hide();
     }
 
-    if (show_searchbox) {
-        auto search_item = new Gtk::MenuItem();
-        search_item -> add(menu.searchbox);
-        search_item -> set_name("search_item");
-        search_item -> set_sensitive(false);
-        menu.append(*search_item);
-    }
+    if (menu) {
+        menu -> signal_deactivate().connect(sigc::ptr_fun(&dmenu_quit));
 
-    menu.signal_deactivate().connect(sigc::ptr_fun(Gtk::Main::quit));
-
-    int cnt = 0;
-    for (auto& command : all_commands) {
-        auto item = new Gtk::MenuItem();
-        item -> set_label(command);
-        item -> signal_activate().connect(sigc::bind<std::string>(sigc::ptr_fun(&on_item_clicked),
-                                                               std::move(command)));
-
-        menu.append(*item);
-        cnt++;
-        if (cnt > rows - 1) {
-            break;
-        }
+        menu -> set_reserve_toggle_size(false);
+        menu -> set_property("width_request", w / 8);
+    } else {
+        list -> set_property("width_request", w / 4);
     }
 
-    menu.set_reserve_toggle_size(false);
-    menu.set_property("width_request", w / 8);
-
     Gtk::Box outer_box(Gtk::ORIENTATION_VERTICAL);
     outer_box.set_spacing(15);
 
@@ -312,12 +355,13 @@ int main(int argc, char *argv[]) {
 
     Gtk::HBox inner_hbox;
 
+    Gtk::Widget& content = list ? static_cast<Gtk::Widget&>(*list) : *anchor;
     if (h_align == "l") {
-        inner_hbox.pack_start(anchor, false, false);
+        inner_hbox.pack_start(content, false, false);
     } else if (h_align == "r") {
-        inner_hbox.pack_end(anchor, false, false);
+        inner_hbox.pack_end(content, false, false);
     } else {
-        inner_hbox.pack_start(anchor, true, false);
+        inner_hbox.pack_start(content, true, false);
     }
 
     if (v_align == "t") {
@@ -332,7 +376,29 @@ int main(int argc, char *argv[]) {
     window.add(outer_box);
     window.show_all_children();
 
-    menu.show_all();
+    if (menu) {
+        // item visibility is managed by DMenu::filter_view, show_all would reveal unused pool items
+        menu -> show();
+    } else if (show_searchbox) {
+        list -> searchbox.grab_focus();
+    }
+
+    tasks.print_trace(std::cout, getenv("NWG_TRACE") != nullptr);
+
+    watch_instance_messages([]() {
+        Gtk::Main::quit();
+    });
+
+    if (resident) {
+        // the window stays hidden until a client asks for the menu
+        DMenuServer server(window, *menu, all_commands);
+        if (!server.start(get_socket_path())) {
+            return EXIT_FAILURE;
+        }
+        dmenu_server = &server;
+        Gtk::Main::run();
+        return 0;
+    }
 
     Gtk::Main::run(window);
 
@@ -24,6 +24,7 @@
 
 #include "nwgconfig.h"
 #include "nwg_classes.h"
+#include "nwg_core.h"
 
 namespace fs = std::filesystem;
 namespace ns = nlohmann;
@@ -34,22 +35,116 @@ extern std::string wm;
 extern std::string settings_file;
 
 extern int rows;
-extern std::vector<Glib::ustring> all_commands;
+extern LineArena all_commands;
 
 extern bool dmenu_run;
 extern bool show_searchbox;
 extern bool case_sensitive;
 
+/*
+ * Matches all_commands against the search phrase: prefix matches first, then substring matches.
+ * The order (by history in run mode) and the folded commands are built once all_commands changed;
+ * if the commands are sorted, prefix matches are looked up by binary search instead of a scan
+ * */
+class CommandFilter {
+    public:
+        void reset();
+        void filter(const Glib::ustring& phrase, std::size_t max, std::vector<std::size_t>& results);
+
+    private:
+        void build_order();
+        void build_folded();
+        template <typename LineAt>
+        void find_sorted(const Matcher&, LineAt&&, std::string_view phrase,
+                         std::size_t max, std::vector<std::size_t>& results) const;
+
+        std::vector<std::size_t> order {};      // all_commands indices, most used first in run mode
+        std::size_t ranked {0};                 // how many of them come from the history
+        std::vector<bool> in_history {};        // by all_commands index
+        LineArena folded {};                    // all_commands case folded, built on the first search
+        bool sorted {false};                    // folded is in byte order, as sort_commands leaves ASCII commands
+        PrefixIndex prefixes {};                // of folded, when sorted
+        ThreadPool pool;                        // matches long lists in parallel, started on the first one
+};
+
 class DMenu : public Gtk::Menu {
     public:
         DMenu();
         Gtk::SearchEntry searchbox;
         Glib::ustring search_phrase;
 
+        void reset();
+
     private:
         bool on_key_press_event(GdkEventKey* event) override;
         void filter_view();
-        void on_item_clicked(Glib::ustring cmd);
+        void on_item_clicked(std::size_t slot);
+
+        CommandFilter filter;
+        std::vector<Gtk::MenuItem*> items {};   // fixed pool of `rows` items, created once
+        std::vector<std::size_t> results {};    // indices into all_commands shown by the items
+};
+
+/*
+ * List model over indices into all_commands: the view asks for the text of the rows
+ * it draws only, so nothing is copied however many commands match
+ * */
+class ResultsModel : public Glib::Object, public Gtk::TreeModel {
+    public:
+        static Glib::RefPtr<ResultsModel> create();
+
+        void set_rows(std::vector<std::size_t>&&);
+        std::size_t size() const { return rows.size(); }
+        std::size_t command(const Path&) const;
+        bool iter_is_valid(const iterator& iter) const override;
+
+    protected:
+        ResultsModel();
+
+        Gtk::TreeModelFlags get_flags_vfunc() const override;
+        int get_n_columns_vfunc() const override;
+        GType get_column_type_vfunc(int index) const override;
+        void get_value_vfunc(const iterator& iter, int column, Glib::ValueBase& value) const override;
+        bool iter_next_vfunc(const iterator& iter, iterator& iter_next) const override;
+        bool iter_children_vfunc(const iterator& parent, iterator& iter) const override;
+        bool iter_has_child_vfunc(const iterator& iter) const override;
+        int iter_n_children_vfunc(const iterator& iter) const override;
+        int iter_n_root_children_vfunc() const override;
+        bool iter_nth_child_vfunc(const iterator& parent, int n, iterator& iter) const override;
+        bool iter_nth_root_child_vfunc(int n, iterator& iter) const override;
+        bool iter_parent_vfunc(const iterator& child, iterator& iter) const override;
+        Path get_path_vfunc(const iterator& iter) const override;
+        bool get_iter_vfunc(const Path& path, iterator& iter) const override;
+
+    private:
+        void set_iter(iterator& iter, std::size_t row) const;
+
+        std::vector<std::size_t> rows {};       // indices into all_commands
+        int stamp {1};                          // changes with the rows, invalidating iterators
+};
+
+/*
+ * Scrollable list of all the matches (-list), instead of the menu of `rows` items
+ * */
+class DMenuList : public Gtk::Box {
+    public:
+        DMenuList();
+        Gtk::SearchEntry searchbox;
+
+        void reset();
+
+    private:
+        void filter_view();
+        bool on_search_key_press(GdkEventKey*);
+        void on_search_activate();
+        void on_row_activated(const Gtk::TreeModel::Path&, Gtk::TreeViewColumn*);
+
+        CommandFilter filter;
+        Glib::RefPtr<ResultsModel> model;
+        Gtk::ScrolledWindow scrolled_window;
+        Gtk::TreeView view;
+        Gtk::TreeViewColumn column;
+        Gtk::CellRendererText renderer;
 };
 
 class Anchor : public Gtk::Button {
@@ -72,10 +167,53 @@ class MainWindow : public CommonWindow {
         bool on_button_press_event(GdkEventButton* button_event);
 };
 
+/*
+ * Resident nwgdmenu: serves menus requested by clients over a unix socket
+ * */
+class DMenuServer {
+    public:
+        DMenuServer(MainWindow&, DMenu&, LineArena);
+        ~DMenuServer();
+
+        bool start(const std::string& socket_path);
+        void finish(std::string_view result);
+        void cancel();
+
+    private:
+        bool on_connection(Glib::IOCondition);
+        bool on_client_data(Glib::IOCondition);
+        void handle_request();
+        void listen();
+
+        MainWindow& window;
+        DMenu& menu;
+        LineArena path_commands;                    // $PATH commands, listed and sorted once
+        int listen_fd {-1};
+        int client_fd {-1};                         // client waiting for the result, if any
+        unsigned serial {0};                        // counts requests, to drop stale cancellations
+        std::string request {};
+};
+
+extern DMenuServer* dmenu_server;
+
+struct HistoryEntry {
+    std::string command;
+    int count;
+    long last_used;     // seconds since epoch
+};
+
 /*
  * Function declarations
  * */
 std::vector<std::string> list_commands();
 std::string get_settings_path();
-
-void on_item_clicked(std::string);
+void sort_commands(LineArena&);
+std::string get_history_path();
+std::vector<HistoryEntry> get_history(const std::string&);
+std::vector<std::size_t> rank_by_history(const LineArena&, std::vector<HistoryEntry>&&);
+void save_to_history(const std::string&, std::string_view);
+void dmenu_quit();
+void dmenu_choose(std::string_view);
+std::string get_socket_path();
+int connect_to_daemon(const std::string&);
+int run_client(int, bool);
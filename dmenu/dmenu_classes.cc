@@ -14,6 +14,8 @@
  * Re-worked for Gtkmm 3.0 by Louis Melahn, L.C. January 31, 2014.
  * */
 
+#include <numeric>
+
 #include "dmenu.h"
 
 Anchor::Anchor(DMenu *menu) : menu{menu} {}
@@ -54,6 +56,27 @@ DMenu::DMenu() {
     searchbox.set_sensitive(false);
     searchbox.set_name("searchbox");
     search_phrase = "";
+
+    if (show_searchbox) {
+        auto search_item = Gtk::manage(new Gtk::MenuItem());
+        search_item -> add(searchbox);
+        search_item -> set_name("search_item");
+        search_item -> set_sensitive(false);
+        this -> append(*search_item);
+        search_item -> show_all();
+    }
+
+    // The items are created once; filter_view only relabels, shows or hides them
+    items.reserve(rows);
+    for (int i = 0; i < rows; i++) {
+        auto item = Gtk::manage(new Gtk::MenuItem());
+        item -> signal_activate().connect(sigc::bind<std::size_t>(sigc::mem_fun
+            (*this, &DMenu::on_item_clicked), i));
+        this -> append(*item);
+        items.push_back(item);
+    }
+    results.reserve(rows);
+    filter_view();
 }
 
 void switch_case_sensitive(std::string filename, bool is_case_sensitive) {
@@ -71,7 +94,7 @@ void switch_case_sensitive(std::string filename, bool is_case_sensitive) {
 bool DMenu::on_key_press_event(GdkEventKey* key_event) {
     if (show_searchbox) {
         if (key_event -> keyval == GDK_KEY_Escape) {
-            Gtk::Main::quit();
+            dmenu_quit();
             return Gtk::Menu::on_key_press_event(key_event);
         } else if (((key_event -> keyval >= GDK_KEY_A && key_event -> keyval <= GDK_KEY_Z)
             || (key_event -> keyval >= GDK_KEY_a && key_event -> keyval <= GDK_KEY_z)
@@ -104,7 +127,9 @@ bool DMenu::on_key_press_event(GdkEventKey* key_event) {
             return true;
         } else if (key_event -> keyval == GDK_KEY_Return) {
             // Workaround to launch the single item which has been selected programmatically
-            this -> get_children()[1] -> activate();
+            if (!results.empty()) {
+                items.front() -> activate();
+            }
             return true;
         } else if (key_event -> keyval == GDK_KEY_Insert) {
             this -> search_phrase = "";
@@ -118,111 +143,382 @@ bool DMenu::on_key_press_event(GdkEventKey* key_event) {
     return Gtk::Menu::on_key_press_event(key_event);
 }
 
-void DMenu::on_item_clicked(Glib::ustring cmd) {
+void DMenu::on_item_clicked(std::size_t slot) {
+    if (slot >= results.size()) {
+        return;
+    }
+    dmenu_choose(all_commands[results[slot]]);
+}
+
+/* Forget what was derived from all_commands */
+void CommandFilter::reset() {
+    this -> order.clear();
+    this -> folded.clear();
+}
+
+/*
+ * Commands launched before come first in run mode, the rest keeps the all_commands order
+ * */
+void CommandFilter::build_order() {
+    order.clear();
+    order.reserve(all_commands.size());
+    in_history.assign(all_commands.size(), false);
+    // The history is only needed in run mode, and only once there is something to show
     if (dmenu_run) {
-        cmd = cmd + " &";
-        const char *command = cmd.c_str();
-        std::system(command);
-    } else {
-        std::cout << cmd;
+        order = rank_by_history(all_commands, get_history(get_history_path()));
+    }
+    ranked = order.size();
+    for (auto i : order) {
+        in_history[i] = true;
+    }
+    for (std::size_t i = 0; i < all_commands.size(); i++) {
+        if (!in_history[i]) {
+            order.push_back(i);
+        }
     }
-    Gtk::Main::quit();
 }
 
-/* Rebuild menu to match the search phrase */
-void DMenu::filter_view() {
-    if (this -> search_phrase.size() > 0) {
-        // remove all items except searchbox
-        for (auto item : this -> get_children()) {
-            if (item -> get_name() != "search_item") {
-                delete item;
-            }
+/*
+ * Folds all_commands, and indexes them by prefix if that leaves them sorted
+ * */
+void CommandFilter::build_folded() {
+    folded.clear();
+    for (std::size_t i = 0; i < all_commands.size(); i++) {
+        folded.add_folded(all_commands[i]);
+    }
+    sorted = prefixes.build(folded);
+}
+
+/*
+ * find over sorted commands: prefix matches come from the range having the folded phrase
+ * as a prefix, in the display order; only substring matches need a scan, if still wanted
+ * */
+template <typename LineAt>
+void CommandFilter::find_sorted(const Matcher& matcher, LineAt&& line_at, std::string_view phrase,
+                                std::size_t max, std::vector<std::size_t>& results) const {
+    auto [start, end] = prefixes.range(folded, fold_case(phrase));
+    for (std::size_t k = 0; k < ranked && results.size() < max; k++) {
+        auto i = order[k];
+        if (i >= start && i < end && matcher.match(line_at(i)) == Matcher::PREFIX) {
+            results.push_back(i);
         }
-        int cnt = 0;
-        bool limit_exhausted = false;
-        for (Glib::ustring command : all_commands) {
-            std::string sf = this -> search_phrase;
-            std::string cm = command;
-            if (!case_sensitive) {
-                for(unsigned int l = 0; l < sf.length(); l++) {
-                   sf[l] = toupper(sf[l]);
-                }
-                for(unsigned int l = 0; l < cm.length(); l++) {
-                   cm[l] = toupper(cm[l]);
-                }
-            }
-            if (cm.find(sf) == 0) {
-                Gtk::MenuItem *item = new Gtk::MenuItem();
-                item -> set_label(command);
-                item -> signal_activate().connect(sigc::bind<Glib::ustring>(sigc::mem_fun
-                    (*this, &DMenu::on_item_clicked), command));
-                this -> append(*item);
-                // This will highlight 1st menu item, still it won't start on Enter.
-                // See workaround in on_key_press_event.
-                if (cnt == 0) {
-                    item -> select();
-                }
-                cnt++;
-                if (cnt > rows - 1) {
-                    limit_exhausted = true;
-                    break;
-                }
-            }
+    }
+    // the commands out of the history follow in all_commands order
+    for (auto i = start; i < end && results.size() < max; i++) {
+        if (!in_history[i] && matcher.match(line_at(i)) == Matcher::PREFIX) {
+            results.push_back(i);
         }
-        if (!limit_exhausted) {
-            for (Glib::ustring command : all_commands) {
-                std::string sf = this -> search_phrase;
-                std::string cm = command;
-                if (!case_sensitive) {
-                    for(unsigned int l = 0; l < sf.length(); l++) {
-                       sf[l] = toupper(sf[l]);
-                    }
-                    for(unsigned int l = 0; l < cm.length(); l++) {
-                       cm[l] = toupper(cm[l]);
-                    }
-                }
-                if (cm.find(sf) != std::string::npos && cm.find(sf) != 0) {
-                    Gtk::MenuItem *item = new Gtk::MenuItem();
-                    item -> set_label(command);
-                    item -> signal_activate().connect(sigc::bind<Glib::ustring>(sigc::mem_fun
-                        (*this, &DMenu::on_item_clicked), cm));
-                    this -> append(*item);
-                    cnt++;
-                    if (cnt > rows - 1) {
-                        break;
-                    }
-                }
-            }
+    }
+    for (auto i : order) {
+        if (results.size() >= max) {
+            break;
+        }
+        if (matcher.match(line_at(i)) == Matcher::SUBSTRING) {
+            results.push_back(i);
         }
-        this -> show_all();
+    }
+}
 
+/*
+ * Replaces results with up to max indices of commands matching the phrase,
+ * or with the first max commands if the phrase is empty
+ * */
+void CommandFilter::filter(const Glib::ustring& phrase, std::size_t max, std::vector<std::size_t>& results) {
+    if (order.size() != all_commands.size()) {
+        build_order();
+    }
+
+    results.clear();
+    if (phrase.empty()) {
+        auto count = std::min(max, order.size());
+        results.assign(order.begin(), order.begin() + count);
+        return;
+    }
+    // the folded commands are needed to tell whether they are sorted, even if the search is case sensitive
+    if (folded.size() != all_commands.size()) {
+        build_folded();
+    }
+    Matcher matcher(phrase.raw(), case_sensitive);
+    auto command_at = [](std::size_t i) { return all_commands[i]; };
+    auto folded_at = [this](std::size_t i) { return folded[i]; };
+    if (sorted && case_sensitive) {
+        find_sorted(matcher, command_at, phrase.raw(), max, results);
+    } else if (sorted) {
+        find_sorted(matcher, folded_at, phrase.raw(), max, results);
+    } else if (case_sensitive) {
+        matcher.find(pool, order, command_at, max, results);
     } else {
+        matcher.find(pool, order, folded_at, max, results);
+    }
+}
+
+/* Start over with the current all_commands */
+void DMenu::reset() {
+    this -> search_phrase = "";
+    this -> filter.reset();
+    this -> filter_view();
+}
+
+/* Relabel the item pool to match the search phrase */
+void DMenu::filter_view() {
+    filter.filter(this -> search_phrase, rows, results);
+    if (this -> search_phrase.empty()) {
         if (case_sensitive) {
             this -> searchbox.set_text("Type To Search");
         } else {
             this -> searchbox.set_text("TYPE TO SEARCH");
         }
-        // remove all items except searchbox
-        for (auto item : this -> get_children()) {
-            if (item -> get_name() != "search_item") {
-                delete item;
-            }
+    }
+
+    for (std::size_t i = 0; i < items.size(); i++) {
+        auto item = items[i];
+        item -> deselect();
+        if (i < results.size()) {
+            auto command = all_commands[results[i]];
+            item -> set_label(Glib::ustring(command.begin(), command.end()));
+            item -> show();
+        } else {
+            item -> hide();
+        }
+    }
+    // This will highlight 1st menu item, still it won't start on Enter.
+    // See workaround in on_key_press_event.
+    if (this -> search_phrase.size() > 0 && !results.empty()) {
+        items.front() -> select();
+    }
+}
+
+ResultsModel::ResultsModel() : Glib::ObjectBase(typeid(ResultsModel)), Glib::Object() {}
+
+Glib::RefPtr<ResultsModel> ResultsModel::create() {
+    return Glib::RefPtr<ResultsModel>(new ResultsModel());
+}
+
+/* Takes over new results; iterators into the previous ones become invalid */
+void ResultsModel::set_rows(std::vector<std::size_t>&& new_rows) {
+    this -> rows = std::move(new_rows);
+    this -> stamp++;
+}
+
+/* Index into all_commands of the row at path */
+std::size_t ResultsModel::command(const Path& path) const {
+    return rows.at(path.front());
+}
+
+void ResultsModel::set_iter(iterator& iter, std::size_t row) const {
+    iter.set_stamp(stamp);
+    iter.gobj() -> user_data = GSIZE_TO_POINTER(row);
+}
+
+Gtk::TreeModelFlags ResultsModel::get_flags_vfunc() const {
+    return Gtk::TREE_MODEL_LIST_ONLY | Gtk::TREE_MODEL_ITERS_PERSIST;
+}
+
+int ResultsModel::get_n_columns_vfunc() const {
+    return 1;
+}
+
+GType ResultsModel::get_column_type_vfunc(int index) const {
+    (void) index; // suppress warning
+    return Glib::Value<Glib::ustring>::value_type();
+}
+
+/* Called for the rows being drawn only */
+void ResultsModel::get_value_vfunc(const iterator& iter, int column, Glib::ValueBase& value) const {
+    (void) column; // suppress warning
+    if (!iter_is_valid(iter)) {
+        return;
+    }
+    Glib::Value<Glib::ustring> text;
+    text.init(text.value_type());
+    auto command = all_commands[rows[GPOINTER_TO_SIZE(iter.gobj() -> user_data)]];
+    text.set(Glib::ustring(command.begin(), command.end()));
+    value.init(text.gobj());
+}
+
+bool ResultsModel::iter_next_vfunc(const iterator& iter, iterator& iter_next) const {
+    if (!iter_is_valid(iter)) {
+        return false;
+    }
+    auto next = GPOINTER_TO_SIZE(iter.gobj() -> user_data) + 1;
+    if (next >= rows.size()) {
+        return false;
+    }
+    set_iter(iter_next, next);
+    return true;
+}
+
+bool ResultsModel::iter_children_vfunc(const iterator& parent, iterator& iter) const {
+    (void) parent; // suppress warning
+    (void) iter;
+    return false;
+}
+
+bool ResultsModel::iter_has_child_vfunc(const iterator& iter) const {
+    (void) iter; // suppress warning
+    return false;
+}
+
+int ResultsModel::iter_n_children_vfunc(const iterator& iter) const {
+    (void) iter; // suppress warning
+    return 0;
+}
+
+int ResultsModel::iter_n_root_children_vfunc() const {
+    return rows.size();
+}
+
+bool ResultsModel::iter_nth_child_vfunc(const iterator& parent, int n, iterator& iter) const {
+    (void) parent; // suppress warning
+    (void) n;
+    (void) iter;
+    return false;
+}
+
+bool ResultsModel::iter_nth_root_child_vfunc(int n, iterator& iter) const {
+    if (n < 0 || static_cast<std::size_t>(n) >= rows.size()) {
+        return false;
+    }
+    set_iter(iter, n);
+    return true;
+}
+
+bool ResultsModel::iter_parent_vfunc(const iterator& child, iterator& iter) const {
+    (void) child; // suppress warning
+    (void) iter;
+    return false;
+}
+
+Gtk::TreeModel::Path ResultsModel::get_path_vfunc(const iterator& iter) const {
+    Path path;
+    if (iter_is_valid(iter)) {
+        path.push_back(GPOINTER_TO_SIZE(iter.gobj() -> user_data));
+    }
+    return path;
+}
+
+bool ResultsModel::get_iter_vfunc(const Path& path, iterator& iter) const {
+    if (path.size() != 1) {
+        return false;
+    }
+    return iter_nth_root_child_vfunc(path.front(), iter);
+}
+
+bool ResultsModel::iter_is_valid(const iterator& iter) const {
+    return iter.get_stamp() == stamp && GPOINTER_TO_SIZE(iter.gobj() -> user_data) < rows.size();
+}
+
+DMenuList::DMenuList() : Gtk::Box(Gtk::ORIENTATION_VERTICAL), model(ResultsModel::create()) {
+    searchbox.set_name("searchbox");
+    searchbox.set_placeholder_text(case_sensitive ? "Type To Search" : "TYPE TO SEARCH");
+    searchbox.signal_search_changed().connect(sigc::mem_fun(*this, &DMenuList::filter_view));
+    searchbox.signal_key_press_event().connect(sigc::mem_fun(*this, &DMenuList::on_search_key_press), false);
+    searchbox.signal_activate().connect(sigc::mem_fun(*this, &DMenuList::on_search_activate));
+    searchbox.signal_stop_search().connect(sigc::ptr_fun(&dmenu_quit));
+
+    // Fixed height rows let the view lay out just the visible part of the list
+    column.pack_start(renderer, true);
+    column.add_attribute(renderer.property_text(), 0);
+    column.set_sizing(Gtk::TREE_VIEW_COLUMN_FIXED);
+    column.set_expand(true);
+    renderer.property_ellipsize() = Pango::ELLIPSIZE_END;
+    view.append_column(column);
+    view.set_fixed_height_mode(true);
+    view.set_headers_visible(false);
+    view.set_enable_search(false);
+    view.set_name("list");
+    view.signal_row_activated().connect(sigc::mem_fun(*this, &DMenuList::on_row_activated));
+    // the view has the focus if there is no search box
+    view.signal_key_press_event().connect([](GdkEventKey* key_event) {
+        if (key_event -> keyval == GDK_KEY_Escape) {
+            dmenu_quit();
+            return true;
         }
-        int cnt = 0;
-        for (Glib::ustring command : all_commands) {
-            Gtk::MenuItem *item = new Gtk::MenuItem();
-            item -> set_label(command);
-            item -> signal_activate().connect(sigc::bind<Glib::ustring>(sigc::mem_fun(*this, &DMenu::on_item_clicked), command));
-            this -> append(*item);
-            cnt++;
-            if (cnt > rows - 1) {
-                break;
+        return false;
+    }, false);
+
+    int min_height, row_height;
+    renderer.get_preferred_height(view, min_height, row_height);
+    scrolled_window.set_policy(Gtk::POLICY_NEVER, Gtk::POLICY_AUTOMATIC);
+    scrolled_window.set_min_content_height(row_height * rows);
+    scrolled_window.add(view);
+
+    if (show_searchbox) {
+        this -> pack_start(searchbox, false, false);
+    }
+    this -> pack_start(scrolled_window, true, true);
+    filter_view();
+}
+
+/* Start over with the current all_commands */
+void DMenuList::reset() {
+    this -> filter.reset();
+    this -> searchbox.set_text("");
+    this -> filter_view();
+}
+
+/* Point the view at all the matches; their text is fetched as rows get drawn */
+void DMenuList::filter_view() {
+    std::vector<std::size_t> results;
+    filter.filter(searchbox.get_text(), all_commands.size(), results);
+    // detached while changing, so that the view rebuilds its rows once instead of hearing of each
+    view.unset_model();
+    model -> set_rows(std::move(results));
+    view.set_model(model);
+    if (model -> size() > 0) {
+        view.set_cursor(Gtk::TreeModel::Path(1, 0));
+    }
+}
+
+/* The search entry keeps the focus, the keys moving through the list are passed on */
+bool DMenuList::on_search_key_press(GdkEventKey* key_event) {
+    switch (key_event -> keyval) {
+        case GDK_KEY_Up:
+        case GDK_KEY_Down:
+        case GDK_KEY_Page_Up:
+        case GDK_KEY_Page_Down: {
+            if (model -> size() == 0) {
+                return true;
             }
+            Gtk::TreeModel::Path path;
+            Gtk::TreeViewColumn* focus_column;
+            view.get_cursor(path, focus_column);
+            int row = path.empty() ? 0 : path.front();
+            int step = key_event -> keyval == GDK_KEY_Up || key_event -> keyval == GDK_KEY_Down ? 1 : rows;
+            if (key_event -> keyval == GDK_KEY_Up || key_event -> keyval == GDK_KEY_Page_Up) {
+                step = -step;
+            }
+            row = std::clamp(row + step, 0, static_cast<int>(model -> size()) - 1);
+            path = Gtk::TreeModel::Path(1, row);
+            view.set_cursor(path);
+            view.scroll_to_row(path);
+            return true;
         }
-        this -> show_all();
+        case GDK_KEY_Insert:
+            case_sensitive = !case_sensitive;
+            switch_case_sensitive(settings_file, case_sensitive);
+            searchbox.set_placeholder_text(case_sensitive ? "Type To Search" : "TYPE TO SEARCH");
+            filter_view();
+            return true;
+        default:
+            return false;
+    }
+}
+
+void DMenuList::on_search_activate() {
+    Gtk::TreeModel::Path path;
+    Gtk::TreeViewColumn* focus_column;
+    view.get_cursor(path, focus_column);
+    if (!path.empty()) {
+        on_row_activated(path, focus_column);
     }
 }
 
+void DMenuList::on_row_activated(const Gtk::TreeModel::Path& path, Gtk::TreeViewColumn* column) {
+    (void) column; // suppress warning
+    dmenu_choose(all_commands[model -> command(path)]);
+}
+
 MainWindow::MainWindow() : CommonWindow("~nwgdmenu", "~nwgdmenu"), menu(nullptr) {
     if (wm == "dwm" || wm == "bspwm" || wm == "qtile" || wm == "bspwm" || wm == "tiling") {
         fullscreen();
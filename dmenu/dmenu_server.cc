@@ -0,0 +1,309 @@
+/* GTK-based dmenu
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * *
+ * The resident mode: `nwgdmenu -daemon` keeps GTK initialized and waits for
+ * `nwgdmenu -client` requests on a unix socket in $XDG_RUNTIME_DIR.
+ *
+ * A request is a header line, "run", "stdin" or "stdin sort", followed by the
+ * client's stdin in the latter cases. The client then shuts down its writing side and
+ * waits for the reply, which is the chosen line, or nothing if the menu was
+ * closed without a choice.
+ * */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+#include "nwg_tools.h"
+#include "dmenu.h"
+
+/*
+ * Writes the whole buffer, returns false on failure
+ * */
+static bool write_all(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        // MSG_NOSIGNAL: a client gone away must not kill the daemon with SIGPIPE
+        auto n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+/*
+ * Fills sockaddr_un with the socket path, returns false if the path is too long
+ * */
+static bool socket_address(const std::string& path, sockaddr_un& addr) {
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "ERROR: Socket path too long: " << path << '\n';
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+/*
+ * Returns daemon socket path
+ * */
+std::string get_socket_path() {
+    return get_runtime_dir() + "/nwgdmenu.sock";
+}
+
+/*
+ * Connects to the daemon, returns the socket or -1 if no daemon is running
+ * */
+int connect_to_daemon(const std::string& path) {
+    sockaddr_un addr {};
+    if (!socket_address(path, addr)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Sends the request over fd and handles the reply the way a standalone nwgdmenu would:
+ * launches the chosen command in run mode, prints it otherwise.
+ * Returns the exit status.
+ * */
+int run_client(int fd, bool sort) {
+    std::string header = dmenu_run ? "run\n" : sort ? "stdin sort\n" : "stdin\n";
+    bool sent = write_all(fd, header.data(), header.size());
+
+    std::array<char, 65536> buffer;
+    if (sent && !dmenu_run) {
+        ssize_t n;
+        while ((n = read(STDIN_FILENO, buffer.data(), buffer.size())) != 0) {
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            if (!write_all(fd, buffer.data(), n)) {
+                sent = false;
+                break;
+            }
+        }
+    }
+    if (!sent) {
+        std::cerr << "ERROR: Failed sending request to nwgdmenu daemon\n";
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    shutdown(fd, SHUT_WR);
+
+    std::string result;
+    ssize_t n;
+    while ((n = read(fd, buffer.data(), buffer.size())) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        result.append(buffer.data(), n);
+    }
+    close(fd);
+
+    if (result.empty()) {
+        return 0;
+    }
+    if (dmenu_run) {
+        auto cmd = result + " &";
+        std::system(cmd.c_str());
+        save_to_history(get_history_path(), result);
+    } else {
+        std::cout << result;
+    }
+    return 0;
+}
+
+/*
+ * Closes the menu: quits, or hands it back to the daemon
+ * */
+void dmenu_quit() {
+    if (dmenu_server) {
+        dmenu_server->cancel();
+    } else {
+        Gtk::Main::quit();
+    }
+}
+
+/*
+ * Launches, prints or hands over the command chosen
+ * */
+void dmenu_choose(std::string_view cmd) {
+    // the client launches or prints the result itself
+    if (dmenu_server) {
+        dmenu_server->finish(cmd);
+        return;
+    }
+    if (dmenu_run) {
+        auto launched = std::string(cmd) + " &";
+        const char *command = launched.c_str();
+        std::system(command);
+        save_to_history(get_history_path(), cmd);
+    } else {
+        std::cout << cmd;
+    }
+    Gtk::Main::quit();
+}
+
+DMenuServer::DMenuServer(MainWindow& window, DMenu& menu, LineArena path_commands)
+ : window(window), menu(menu), path_commands(std::move(path_commands)) {}
+
+DMenuServer::~DMenuServer() {
+    if (client_fd >= 0) {
+        close(client_fd);
+    }
+    if (listen_fd >= 0) {
+        close(listen_fd);
+    }
+}
+
+bool DMenuServer::start(const std::string& socket_path) {
+    sockaddr_un addr {};
+    if (!socket_address(socket_path, addr)) {
+        return false;
+    }
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        std::cerr << "ERROR: Failed creating socket: " << std::strerror(errno) << '\n';
+        return false;
+    }
+    // only one daemon runs at a time (see ensure_single_instance), so the socket is stale
+    unlink(socket_path.c_str());
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(listen_fd, 16) < 0) {
+        std::cerr << "ERROR: Failed listening on " << socket_path << ": " << std::strerror(errno) << '\n';
+        return false;
+    }
+    this -> listen();
+    std::cout << "Listening on " << socket_path << '\n';
+    return true;
+}
+
+/*
+ * Starts accepting the next request
+ * */
+void DMenuServer::listen() {
+    Glib::signal_io().connect(sigc::mem_fun(*this, &DMenuServer::on_connection), listen_fd, Glib::IO_IN);
+}
+
+bool DMenuServer::on_connection(Glib::IOCondition condition) {
+    (void) condition; // suppress warning
+
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+        return true;
+    }
+    client_fd = fd;
+    request.clear();
+    Glib::signal_io().connect(sigc::mem_fun(*this, &DMenuServer::on_client_data),
+                              client_fd, Glib::IO_IN | Glib::IO_HUP);
+    // One request at a time, the following ones wait in the listen backlog
+    return false;
+}
+
+bool DMenuServer::on_client_data(Glib::IOCondition condition) {
+    (void) condition; // suppress warning
+
+    std::array<char, 65536> buffer;
+    auto n = read(client_fd, buffer.data(), buffer.size());
+    if (n > 0) {
+        request.append(buffer.data(), n);
+        return true;
+    }
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return true;
+    }
+    if (n < 0) {
+        std::cerr << "ERROR: Failed reading request: " << std::strerror(errno) << '\n';
+        close(client_fd);
+        client_fd = -1;
+        this -> listen();
+        return false;
+    }
+    // the client has sent everything
+    this -> handle_request();
+    return false;
+}
+
+/*
+ * Fills the menu out of the request and shows it
+ * */
+void DMenuServer::handle_request() {
+    auto newline = request.find('\n');
+    std::string_view header = std::string_view(request).substr(0, newline);
+    dmenu_run = header == "run";
+
+    all_commands.clear();
+    if (dmenu_run) {
+        all_commands = path_commands;
+    } else if (newline != std::string::npos) {
+        bool sort = header == "stdin sort";
+        // the body becomes the lines buffer
+        request.erase(0, newline + 1);
+        all_commands.assign(std::move(request));
+        if (sort) {
+            sort_commands(all_commands);
+        }
+    }
+    request.clear();
+    request.shrink_to_fit();
+
+    serial++;
+    menu.reset();
+    window.show();
+}
+
+/*
+ * Sends the result to the waiting client and hides the menu
+ * */
+void DMenuServer::finish(std::string_view result) {
+    if (client_fd < 0) {
+        return;
+    }
+    write_all(client_fd, result.data(), result.size());
+    close(client_fd);
+    client_fd = -1;
+
+    menu.popdown();
+    window.hide();
+    this -> listen();
+}
+
+/*
+ * Closes the menu without a result
+ * */
+void DMenuServer::cancel() {
+    // The menu is deactivated before the chosen item is activated,
+    // so let the item finish the request first
+    Glib::signal_idle().connect_once([this, request_serial = serial]() {
+        if (request_serial == serial) {
+            finish("");
+        }
+    });
+}
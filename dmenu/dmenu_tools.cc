@@ -6,6 +6,11 @@
  * License: GPL3
  * */
 
+#include <cmath>
+#include <ctime>
+#include <numeric>
+#include <unordered_map>
+
 #include "nwg_tools.h"
 #include "dmenu.h"
 
@@ -29,6 +34,26 @@ std::string get_settings_path() {
     return full_path;
 }
 
+/*
+ * Returns launch history file path
+ * */
+std::string get_history_path() {
+    std::string s = "";
+    char* val = getenv("XDG_CACHE_HOME");
+    if (val) {
+        s = val;
+    } else {
+        val = getenv("HOME");
+        s = val;
+        s += "/.cache";
+    }
+    fs::path dir (s);
+    fs::path file ("nwg-dmenu-history");
+    fs::path full_path = dir / file;
+
+    return full_path;
+}
+
 /*
  * Returns all command paths
  * */
@@ -50,13 +75,139 @@ std::vector<std::string> list_commands() {
     return command_paths;
 }
 
-void on_item_clicked(std::string cmd) {
-    if (dmenu_run) {
-        cmd = cmd + " &";
-        const char *command = cmd.c_str();
-        std::system(command);
+/*
+ * Sorts commands case insensitive by precomputed collation keys
+ * */
+void sort_commands(LineArena& commands) {
+    // Pure ASCII input can be folded bytewise, anything else needs locale-aware keys;
+    // both kinds of keys can not be mixed, as they do not compare to each other
+    bool ascii = true;
+    for (std::size_t i = 0; i < commands.size() && ascii; i++) {
+        ascii = is_ascii(commands[i]);
+    }
+
+    LineArena keys;
+    for (std::size_t i = 0; i < commands.size(); i++) {
+        auto command = commands[i];
+        if (ascii) {
+            keys.add_folded(command);
+        } else {
+            gchar* folded = g_utf8_casefold(command.data(), command.size());
+            gchar* key = g_utf8_collate_key(folded, -1);
+            keys.add(key);
+            g_free(key);
+            g_free(folded);
+        }
+    }
+
+    std::vector<std::size_t> order(commands.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&keys](auto a, auto b) {
+        return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+    });
+
+    commands.permute(order);
+}
+
+// Number of commands kept in the launch history file
+static constexpr std::size_t HISTORY_SIZE = 100;
+
+/*
+ * Returns history entry weight: launch count, halved for every week since the last launch
+ * */
+static double history_score(const HistoryEntry& entry, std::time_t now) {
+    double age_weeks = std::max(0.0, static_cast<double>(now - entry.last_used)) / (7 * 24 * 3600);
+    return entry.count / std::exp2(age_weeks);
+}
+
+using HistoryIterator = std::vector<HistoryEntry>::iterator;
+
+static void sort_by_score(HistoryIterator first, HistoryIterator last) {
+    auto now = std::time(nullptr);
+    std::stable_sort(first, last, [now](auto& a, auto& b) {
+        return history_score(a, now) > history_score(b, now);
+    });
+}
+
+static void sort_by_score(std::vector<HistoryEntry>& history) {
+    sort_by_score(history.begin(), history.end());
+}
+
+/*
+ * Returns history entries out of the history file,
+ * one "<count> <last used> <command>" line per command
+ * */
+std::vector<HistoryEntry> get_history(const std::string& history_file) {
+    std::vector<HistoryEntry> history;
+    std::ifstream in(history_file);
+    int count;
+    long last_used;
+    while (in >> count >> last_used) {
+        in.get(); // the space separating the command
+        std::string command;
+        if (!std::getline(in, command)) {
+            break;
+        }
+        if (!command.empty() && count > 0) {
+            history.push_back({std::move(command), count, last_used});
+        }
+    }
+    return history;
+}
+
+/*
+ * Returns indices of the commands found in the history, most used first
+ * */
+std::vector<std::size_t> rank_by_history(const LineArena& commands,
+                                         std::vector<HistoryEntry>&& history) {
+    std::vector<std::size_t> ranked;
+    if (history.empty()) {
+        return ranked;
+    }
+    sort_by_score(history);
+    std::unordered_map<std::string_view, std::size_t> positions;
+    positions.reserve(commands.size());
+    for (std::size_t i = 0; i < commands.size(); i++) {
+        positions.emplace(commands[i], i);
+    }
+    for (auto& entry : history) {
+        if (auto it = positions.find(entry.command); it != positions.end()
+            && std::find(ranked.begin(), ranked.end(), it->second) == ranked.end()) {
+            ranked.push_back(it->second);
+        }
+    }
+    return ranked;
+}
+
+/*
+ * Records a launched command and saves the history file, keeping it bounded to HISTORY_SIZE:
+ * the launched command and the best scored others
+ * */
+void save_to_history(const std::string& history_file, std::string_view command) {
+    auto history = get_history(history_file);
+    long now = std::time(nullptr);
+
+    auto it = std::find_if(history.begin(), history.end(), [&command](auto& entry) {
+        return entry.command == command;
+    });
+    if (it != history.end()) {
+        it->count++;
+        it->last_used = now;
     } else {
-        std::cout << cmd;
+        history.push_back({std::string(command), 1, now});
+        it = history.end() - 1;
+    }
+    if (history.size() > HISTORY_SIZE) {
+        // a new command scores low, yet it must stay for the history to learn it
+        std::iter_swap(history.begin(), it);
+        sort_by_score(history.begin() + 1, history.end());
+        history.resize(HISTORY_SIZE);
+    }
+
+    // several instances may save at once, each one replaces the file as a whole
+    std::string content;
+    for (auto& entry : history) {
+        content += std::to_string(entry.count) + ' ' + std::to_string(entry.last_used) + ' ' + entry.command + '\n';
     }
-    Gtk::Main::quit();
+    save_string_to_file(content, history_file);
 }
@@ -15,6 +15,7 @@
 #include "nwg_tools.h"
 #include "nwg_classes.h"
 #include "on_event.h"
+#include "task_graph.h"
 #include "grid.h"
 
 bool pins = false;              // whether to display pinned
@@ -26,7 +27,7 @@ Gtk::Label *description;
 
 std::string pinned_file {};
 std::vector<std::string> pinned;    // list of commands of pinned icons
-ns::json cache;
+std::map<std::string, int> cache;     // exec -> clicks
 std::string cache_file {};
 
 const char* const HELP_MESSAGE =
@@ -36,13 +37,16 @@ Options:\n\
 -h               show this help message and exit\n\
 -f               display favourites (most used entries)\n\
 -p               display pinned entries \n\
+-g               display entries by category\n\
 -o <opacity>     default (black) background opacity (0.0 - 1.0, default 0.9)\n\
 -b <background>  background colour in RRGGBB or RRGGBBAA format (RRGGBBAA alpha overrides <opacity>)\n\
 -n <col>         number of grid columns (default: 6)\n\
 -s <size>        button image size (default: 72)\n\
 -c <name>        css file name (default: style.css)\n\
 -l <ln>          force use of <ln> language\n\
--wm <wmname>     window manager name (if can not be detected)\n";
+-wm <wmname>     window manager name (if can not be detected)\n\
+-stats           print memory and allocation stats at exit\n\
+-stats-json <file> dump memory and allocation stats to <file> at exit, as JSON\n";
 
 int main(int argc, char *argv[]) {
     bool favs (false);              // whether to display favourites
@@ -52,7 +56,7 @@ int main(int argc, char *argv[]) {
     gettimeofday(&tp, NULL);
     long int start_ms = tp.tv_sec * 1000 + tp.tv_usec / 1000;
 
-    create_pid_file_or_kill_pid("nwggrid");
+    ensure_single_instance("nwggrid");
 
     std::string lang ("");
 
@@ -67,6 +71,7 @@ int main(int argc, char *argv[]) {
     if (input.cmdOptionExists("-p")){
         pins = true;
     }
+    bool by_category = input.cmdOptionExists("-g");
     auto forced_lang = input.getCmdOption("-l");
     if (!forced_lang.empty()){
         lang = forced_lang;
@@ -130,56 +135,10 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    if (favs) {
-        cache_file = get_cache_path();
-        try {
-            cache = get_cache(cache_file);
-        }  catch (...) {
-            std::cout << "Cache file not found, creating...\n";
-            save_json(cache, cache_file);
-        }
-        if (cache.size() > 0) {
-            std::cout << cache.size() << " cache entries loaded\n";
-        } else {
-            std::cout << "No cached favourites found\n";
-            favs = false;   // ignore -f argument from now on
-        }
-    }
-
-    if (pins) {
-        pinned_file = get_pinned_path();
-        pinned = get_pinned(pinned_file);
-        if (pinned.size() > 0) {
-          std::cout << pinned.size() << " pinned entries loaded\n";
-        } else {
-          std::cout << "No pinned entries found\n";
-        }
-    }
-
-    std::string config_dir = get_config_dir("nwggrid");
-    if (!fs::is_directory(config_dir)) {
-        std::cout << "Config dir not found, creating...\n";
-        fs::create_directories(config_dir);
-    }
-
-    // default and custom style sheet
-    std::string default_css_file = config_dir + "/style.css";
-    // css file to be used
-    std::string css_file = config_dir + "/" + custom_css_file;
-    // copy default file if not found
-    if (!fs::exists(default_css_file)) {
-        try {
-            fs::copy_file(DATA_DIR_STR "/nwggrid/style.css", default_css_file, fs::copy_options::overwrite_existing);
-        } catch (...) {
-            std::cerr << "Failed copying default style.css\n";
-        }
-    }
-
-    // This will be read-only, to find n most clicked items (n = number of grid columns)
-    std::vector<CacheEntry> favourites {};
-    if (cache.size() > 0) {
-        auto n = cache.size() >= static_cast<std::size_t>(num_col) ? num_col : cache.size();
-        favourites = get_favourites(std::move(cache), n);
+    bool stats = input.cmdOptionExists("-stats");
+    auto stats_file = input.getCmdOption("-stats-json");
+    if (stats || !stats_file.empty()) {
+        start_alloc_stats();
     }
 
     /* get current WM name if not forced */
@@ -194,43 +153,115 @@ int main(int argc, char *argv[]) {
     }
     std::cout << "Locale: " << lang << "\n";
 
-    /* get all applications dirs */
-    std::vector<std::string> app_dirs = get_app_dirs();
-
-    /* get a list of paths to all *.desktop entries */
-    std::vector<std::string> entries = list_entries(app_dirs);
-    std::cout << entries.size() << " .desktop entries found, ";
+    std::string config_dir = get_config_dir("nwggrid");
+    // default and custom style sheet
+    std::string default_css_file = config_dir + "/style.css";
+    // css file to be used
+    std::string css_file = config_dir + "/" + custom_css_file;
 
-    /* create the vector of DesktopEntry structs */
+    std::vector<std::string> app_dirs {};       // all applications dirs
+    std::vector<std::string> entries {};        // paths to all *.desktop entries
+    StringPool strings;                         // text of DesktopEntry structs, stored once
     std::vector<DesktopEntry> desktop_entries {};
-    int hidden {0};
-    for (auto& entry_ : entries) {
-        // string path -> DesktopEntry
-        auto entry = desktop_entry(std::move(entry_), lang);
-        if (entry.no_display) {
-            hidden++;
+    auto corpus = std::make_shared<SearchCorpus>();
+    std::vector<DesktopEntry> indexed_entries {};
+    std::optional<Geometry> sway_output;
+
+    /* Phases below run on worker threads while GTK initializes, data is joined where needed;
+     * the data is declared above, so that it outlives the tasks */
+    init_locale();
+    TaskGraph tasks;
+
+    auto config_task = tasks.add("config", [&] {
+        AllocPhase phase(StatsPhase::Config);
+        if (!fs::is_directory(config_dir)) {
+            std::cout << "Config dir not found, creating...\n";
+            fs::create_directories(config_dir);
         }
-
-        // only add if 'name' and 'exec' not empty
-        if (!entry.name.empty() && !entry.exec.empty()) {
-            // avoid adding duplicates
-            bool found = false;
-            for (auto& e: desktop_entries) {
-                // Checking the mime_type field should resolve #89
-                if (entry.name == e.name && entry.exec == e.exec && entry.mime_type == e.mime_type) {
-                    found = true;
-                }
+        // copy default file if not found
+        if (!fs::exists(default_css_file)) {
+            try {
+                fs::copy_file(DATA_DIR_STR "/nwggrid/style.css", default_css_file, fs::copy_options::overwrite_existing);
+            } catch (...) {
+                std::cerr << "Failed copying default style.css\n";
             }
-            if (!found) {
-                desktop_entries.emplace_back(std::move(entry));
+        }
+    });
+
+    auto cache_task = tasks.add("cache", [&] {
+        AllocPhase phase(StatsPhase::Cache);
+        if (favs) {
+            cache_file = get_cache_path();
+            try {
+                cache = get_cache(cache_file);
+            }  catch (...) {
+                std::cout << "Cache file not found, creating...\n";
+                save_json(cache, cache_file);
+            }
+            if (cache.size() > 0) {
+                std::cout << cache.size() << " cache entries loaded\n";
+            } else {
+                std::cout << "No cached favourites found\n";
+                favs = false;   // ignore -f argument from now on
             }
         }
-    }
-    std::cout << desktop_entries.size() << " unique, " << hidden << " hidden by NoDisplay=true\n";
+        if (pins) {
+            pinned_file = get_pinned_path();
+            pinned = get_pinned(pinned_file);
+            if (pinned.size() > 0) {
+              std::cout << pinned.size() << " pinned entries loaded\n";
+            } else {
+              std::cout << "No pinned entries found\n";
+            }
+        }
+    });
+
+    auto scan_task = tasks.add("scan", [&] {
+        AllocPhase phase(StatsPhase::Scan);
+        app_dirs = get_app_dirs();
+        entries = list_entries(app_dirs);
+    });
+
+    auto parse_task = tasks.add("parse", [&] {
+        AllocPhase phase(StatsPhase::Parse);
+        auto found = entries.size();
+        desktop_entries = load_entries(std::move(entries), lang, strings);
+        auto hidden = std::count_if(desktop_entries.begin(), desktop_entries.end(), [](auto& e) { return e.no_display; });
+        std::cout << found << " .desktop entries found, " << desktop_entries.size() << " unique and available here, "
+                  << hidden << " hidden by NoDisplay=true\n";
+    }, {scan_task});
+
+    /* Index all desktop entries but the pinned ones, they refer to the text in the pool */
+    auto index_task = tasks.add("index", [&] {
+        AllocPhase phase(StatsPhase::Index);
+        for (auto& entry : desktop_entries) {
+            // Ignore .desktop entries with NoDisplay=true
+            if (!entry.no_display) {
+                if (std::find(pinned.begin(), pinned.end(), entry.exec) == pinned.end()) {
+                    add_to_corpus(*corpus, entry);
+                    indexed_entries.push_back(entry);
+                }
+            }
+        }
+    }, {parse_task, cache_task});
+
+    /* turn off borders, enable floating on sway; get the focused output meanwhile */
+    auto sway_task = tasks.add("sway", [&] {
+        AllocPhase phase(StatsPhase::Sway);
+        if (wm == "sway") {
+            auto* cmd = "swaymsg for_window [title=\"~nwggrid*\"] floating enable";
+            std::system(cmd);
+            cmd = "swaymsg for_window [title=\"~nwggrid*\"] border none";
+            std::system(cmd);
+        }
+        sway_output = focused_output_geometry(wm);
+    });
 
-    /* sort above by the 'name' field */
-    std::sort(desktop_entries.begin(), desktop_entries.end(), [](auto& a, auto& b) { return a.name < b.name; });
+    tasks.run();
 
+    std::optional<TaskGraph::Phase> gtk_phase;
+    gtk_phase.emplace(tasks, "gtk");
+    set_alloc_phase(StatsPhase::Gtk);
     auto app = Gtk::Application::create();
 
     auto provider = Gtk::CssProvider::create();
@@ -247,6 +278,7 @@ int main(int argc, char *argv[]) {
     }
     auto& icon_theme_ref = *icon_theme.get();
 
+    tasks.wait(config_task);
     if (std::filesystem::is_regular_file(css_file)) {
         provider->load_from_path(css_file);
         std::cout << "Using " << css_file << '\n';
@@ -255,26 +287,30 @@ int main(int argc, char *argv[]) {
         std::cout << "Using " << default_css_file << '\n';
     }
 
+    // the window rules must be in place before the window shows up
+    tasks.wait(sway_task);
     MainWindow window;
 
     window.show();
 
     /* Detect focused display geometry: {x, y, width, height} */
-    auto geometry = display_geometry(wm, display, window.get_window());
+    auto geometry = display_geometry(sway_output, display, window.get_window());
     std::cout << "Focused display: " << geometry.x << ", " << geometry.y << ", " << geometry.width << ", "
     << geometry.height << '\n';
+    gtk_phase.reset();
+    set_alloc_phase(StatsPhase::Window);
 
     int x = geometry.x;
     int y = geometry.y;
     int w = geometry.width;
     int h = geometry.height;
 
-    /* turn off borders, enable floating on sway */
-    if (wm == "sway") {
-        auto* cmd = "swaymsg for_window [title=\"~nwggrid*\"] floating enable";
-        std::system(cmd);
-        cmd = "swaymsg for_window [title=\"~nwggrid*\"] border none";
-        std::system(cmd);
+    // This will be read-only, to find n most clicked items (n = number of grid columns)
+    tasks.wait(cache_task);
+    std::vector<CacheEntry> favourites {};
+    if (cache.size() > 0) {
+        auto n = cache.size() >= static_cast<std::size_t>(num_col) ? num_col : cache.size();
+        favourites = get_favourites(cache, n);
     }
 
     if (wm == "sway" || wm == "i3" || wm == "openbox") {
@@ -292,28 +328,29 @@ int main(int argc, char *argv[]) {
 
     outer_box.pack_start(hbox_header, Gtk::PACK_SHRINK, Gtk::PACK_EXPAND_PADDING);
 
+    Gtk::HBox categories_hbox;
+    if (by_category) {
+        categories_hbox.pack_start(window.categories_box, Gtk::PACK_EXPAND_PADDING);
+        outer_box.pack_start(categories_hbox, Gtk::PACK_SHRINK);
+    }
+
     Gtk::ScrolledWindow scrolled_window;
     scrolled_window.set_propagate_natural_height(true);
     scrolled_window.set_propagate_natural_width(true);
     scrolled_window.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_ALWAYS);
 
-    /* Create buttons for all desktop entries */
-    /* @Siborgium: We can not std::move them here, it breaks favourites: (de.exec == entry.exec) is always false */
-    for (auto& entry : desktop_entries) {
-        // Ignore .desktop entries with NoDisplay=true
-        if (!entry.no_display) {
-            if (std::find(pinned.begin(), pinned.end(), entry.exec) == pinned.end()) {
-                 auto& ab = window.all_boxes.emplace_back(entry.name,
-                                                          entry.exec,
-                                                          entry.comment,
-                                                          false);
-                 Gtk::Image* image = app_image(icon_theme_ref, entry.icon);
-                 ab.set_image_position(Gtk::POS_TOP);
-                 ab.set_image(*image);
-            }
-        }
+    tasks.wait(index_task);
+    window.icon_theme = icon_theme;
+    window.by_category = by_category;
+    window.lang = lang;
+    window.entries = std::move(indexed_entries);
+    // from now on searched by the search worker as well, read only
+    window.corpus = std::move(corpus);
+    window.indexed_boxes.resize(window.entries.size());
+    if (by_category) {
+        window.build_categories();
     }
-    window.label_desc.set_text(std::to_string(window.all_boxes.size()));
+    window.label_desc.set_text(std::to_string(window.entries.size()));
 
     /* Create buttons for favourites */
     if (favs && favourites.size() > 0) {
@@ -333,10 +370,13 @@ int main(int argc, char *argv[]) {
                         continue;
                     }
 
-                    auto& ab = window.fav_boxes.emplace_back(std::move(de.name),
-                                                             std::move(de.exec),
-                                                             std::move(de.comment),
+                    auto& ab = window.fav_boxes.emplace_back(de.name,
+                                                             de.exec,
+                                                             de.comment,
                                                              false);
+                    if (!de.actions.empty()) {
+                        ab.entry = &window.box_entries.emplace_back(de);
+                    }
 
                     Gtk::Image* image = app_image(icon_theme_ref, de.icon);
                     ab.set_image_position(Gtk::POS_TOP);
@@ -351,10 +391,13 @@ int main(int argc, char *argv[]) {
         for(auto& entry : desktop_entries) {
             if (!entry.no_display) {
                 if (std::find(pinned.begin(), pinned.end(), entry.exec) != pinned.end()) {
-                    auto& ab = window.pinned_boxes.emplace_back(std::move(entry.name),
-                                                                std::move(entry.exec),
-                                                                std::move(entry.comment),
+                    auto& ab = window.pinned_boxes.emplace_back(entry.name,
+                                                                entry.exec,
+                                                                entry.comment,
                                                                 true);
+                    if (!entry.actions.empty()) {
+                        ab.entry = &window.box_entries.emplace_back(entry);
+                    }
                     Gtk::Image* image = app_image(icon_theme_ref, entry.icon);
                     ab.set_image_position(Gtk::POS_TOP);
                     ab.set_image(*image);
@@ -395,18 +438,11 @@ int main(int argc, char *argv[]) {
         window.favs_grid.thaw_child_notify();
     }
 
-    column = 0;
-    row = 0;
-    for (auto& box : window.all_boxes) {
-        window.apps_grid.freeze_child_notify();
-        window.apps_grid.attach(box, column, row, 1, 1);
-        if (column < num_col - 1) {
-            column++;
-        } else {
-            column = 0;
-            row++;
-        }
-        window.apps_grid.thaw_child_notify();
+    /* Buttons of all entries are created once the window is up, or per page by category */
+    if (by_category) {
+        window.show_category(window.category);
+    } else {
+        window.populate();
     }
 
     Gtk::VBox inner_vbox;
@@ -457,12 +493,36 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // Startup-only buffers; the pool stays, as the boxes refer to it
+    std::vector<std::string>().swap(app_dirs);
+    std::vector<std::string>().swap(entries);
+    std::vector<DesktopEntry>().swap(desktop_entries);
+    std::vector<CacheEntry>().swap(favourites);
+    strings.drop_index();
+
     gettimeofday(&tp, NULL);
     long int end_ms = tp.tv_sec * 1000 + tp.tv_usec / 1000;
 
     std::cout << "Time: " << end_ms - start_ms << "ms\n";
+    std::cout << "Strings: " << strings.bytes() << " bytes, RSS: " << get_rss_kb() << " kB\n";
+    tasks.print_trace(std::cout, getenv("NWG_TRACE") != nullptr);
+
+    watch_instance_messages([&window]() {
+        window.quit();
+    });
 
+    set_alloc_phase(StatsPhase::Run);
     app->run(window);
 
+    if (stats || !stats_file.empty()) {
+        auto report = memory_stats(window, strings);
+        if (stats) {
+            print_memory_stats(report, std::cout);
+        }
+        if (!stats_file.empty()) {
+            save_json(report, std::string(stats_file));
+        }
+    }
+
     return 0;
 }
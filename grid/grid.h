@@ -11,7 +11,16 @@
 #include <sys/file.h>
 #include <fcntl.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <fstream>
 #include <filesystem>
 
@@ -22,6 +31,7 @@
 
 #include "nwgconfig.h"
 #include "nwg_classes.h"
+#include "nwg_core.h"
 
 namespace fs = std::filesystem;
 namespace ns = nlohmann;
@@ -34,19 +44,20 @@ extern Gtk::Label *description;
 
 extern std::string pinned_file;
 extern std::vector<std::string> pinned;
-extern ns::json cache;
+extern std::map<std::string, int> cache;     // exec -> clicks
 extern std::string cache_file;
 
 class GridBox : public AppBox {
 public:
     /* name, exec, comment, pinned */
-    GridBox(Glib::ustring, Glib::ustring, Glib::ustring, bool);
+    GridBox(std::string_view, std::string_view, std::string_view, bool);
     bool on_button_press_event(GdkEventButton*) override;
     bool on_focus_in_event(GdkEventFocus*) override;
     void on_enter() override;
     void on_activate() override;
 
     bool pinned;
+    const DesktopEntry* entry {nullptr};    // for its actions
 };
 
 class GridSearch : public Gtk::SearchEntry {
@@ -55,10 +66,57 @@ public:
     void prepare_to_insertion();
 };
 
+// Work on idle yields to the main loop once it takes longer than this, half of a 60 Hz frame
+constexpr std::chrono::microseconds FRAME_BUDGET {8000};
+// Candidates verified between checks for a newer search
+constexpr std::size_t FILTER_SLICE = 256;
+
+/*
+ * Searches on a worker thread; only the newest request is processed,
+ * a newer request cancels the one in progress
+ * */
+class SearchWorker {
+    public:
+        struct Result {
+            std::uint64_t generation;
+            std::vector<std::uint32_t> ids;     // ascending
+        };
+
+        SearchWorker();
+        ~SearchWorker();
+
+        void search(std::uint64_t, std::string, std::shared_ptr<const SearchCorpus>);
+        std::optional<Result> take_result();
+        Glib::Dispatcher& signal_done() { return dispatcher; }
+
+    private:
+        struct Request {
+            std::uint64_t generation;
+            std::string phrase;
+            std::shared_ptr<const SearchCorpus> corpus;
+        };
+        void run();
+
+        Glib::Dispatcher dispatcher;            // emitted by the worker, handled on the main thread
+        std::mutex mutex;                       // guards request and result
+        std::condition_variable wakeup;
+        std::optional<Request> request {};
+        std::optional<Result> result {};
+        std::atomic<std::uint64_t> latest {0};  // generation of the newest request
+        std::atomic<bool> stopping {false};
+        std::thread thread;                     // last, starts when everything else is ready
+};
+
 class MainWindow : public CommonWindow {
     public:
         MainWindow();
 
+        void build_categories();
+        void populate();
+        void show_category(std::size_t);
+        GridBox& get_box(std::uint32_t);
+        void show_actions(GridBox&);
+
         GridSearch searchbox;                   // Search apps
         Gtk::Label label_desc;                  // To display .desktop entry Comment field at the bottom
         Gtk::Grid apps_grid;                    // All application buttons grid
@@ -70,19 +128,56 @@ class MainWindow : public CommonWindow {
         std::list<GridBox*> filtered_boxes {};  // attached to apps_grid filtered view
         std::list<GridBox> fav_boxes {};        // attached to favs_grid
         std::list<GridBox> pinned_boxes {};     // attached to pinned_grid
+        std::list<DesktopEntry> box_entries {}; // of favourite and pinned boxes having actions, outliving startup data
+        Gtk::Box categories_box;                // category tabs
+        std::shared_ptr<const SearchCorpus> corpus; // over entries
+        std::vector<DesktopEntry> entries {};   // index document id -> entry
+        std::vector<GridBox*> indexed_boxes {}; // index document id -> box, null until built
+        std::size_t category {0};               // displayed category
+        bool by_category {false};               // whether to display entries by category
+        Glib::RefPtr<Gtk::IconTheme> icon_theme;
+        std::string lang {};                    // of the action names
 
     private:
         //Override default signal handler:
         bool on_key_press_event(GdkEventKey* event) override;
         bool on_button_press_event(GdkEventButton* event) override;
-        void filter_view();
+        void on_search_changed();
+        void on_search_done();
+        bool filter_view();
+        bool on_populate();
         void rebuild_grid(bool filtered);
+
+        sigc::connection populate_idle;
+        std::uint32_t populated {0};                // entries from the first one with boxes created in order
+
+        SearchWorker worker;
+        std::uint64_t generation {0};               // of the latest search phrase
+        sigc::connection filter_idle;               // pending application of the latest results
+        std::vector<std::uint32_t> found {};        // results of the latest search
+        std::size_t found_built {0};                // boxes of the results created so far
+
+        Gtk::Popover actions_popover;               // desktop actions of an entry, filled when shown
+        Gtk::Box actions_box {Gtk::ORIENTATION_VERTICAL};
 };
 
-struct CacheEntry {
-    std::string exec;
-    int clicks;
-    CacheEntry(std::string, int);
+/*
+ * Phases allocations are attributed to in the -stats mode
+ * */
+enum class StatsPhase : std::size_t {
+    Main, Config, Cache, Scan, Parse, Index, Sway, Gtk, Window, Run, Search, Count
+};
+
+/*
+ * Attributes allocations of the calling thread to a phase, while in scope
+ * */
+class AllocPhase {
+    public:
+        explicit AllocPhase(StatsPhase);
+        AllocPhase(const AllocPhase&) = delete;
+        ~AllocPhase();
+    private:
+        StatsPhase previous;
 };
 
 /*
@@ -92,9 +187,8 @@ std::string get_cache_path(void);
 std::string get_pinned_path(void);
 void add_and_save_pinned(const std::string&);
 void remove_and_save_pinned(const std::string&);
-std::vector<std::string> get_app_dirs(void);
-std::vector<std::string> list_entries(const std::vector<std::string>&);
-DesktopEntry desktop_entry(std::string&&, const std::string&);
-ns::json get_cache(const std::string&);
 std::vector<std::string> get_pinned(const std::string&);
-std::vector<CacheEntry> get_favourites(ns::json&&, int);
+void start_alloc_stats(void);
+void set_alloc_phase(StatsPhase);
+ns::json memory_stats(MainWindow&, const StringPool&);
+void print_memory_stats(const ns::json&, std::ostream&);
@@ -14,13 +14,19 @@
  * Re-worked for Gtkmm 3.0 by Louis Melahn, L.C. January 31, 2014.
  * */
 
+#include <algorithm>
+#include <chrono>
+
 #include "nwg_tools.h"
 #include "grid.h"
 
 MainWindow::MainWindow(): CommonWindow("~nwggrid", "~nwggrid") {
     searchbox
         .signal_search_changed()
-        .connect(sigc::mem_fun(*this, &MainWindow::filter_view));
+        .connect(sigc::mem_fun(*this, &MainWindow::on_search_changed));
+    worker
+        .signal_done()
+        .connect(sigc::mem_fun(*this, &MainWindow::on_search_done));
     apps_grid.set_column_spacing(5);
     apps_grid.set_row_spacing(5);
     apps_grid.set_column_homogeneous(true);
@@ -30,6 +36,9 @@ MainWindow::MainWindow(): CommonWindow("~nwggrid", "~nwggrid") {
     pinned_grid.set_column_spacing(5);
     pinned_grid.set_row_spacing(5);
     pinned_grid.set_column_homogeneous(true);
+    categories_box.set_spacing(5);
+    actions_popover.set_name("actions");
+    actions_popover.add(actions_box);
     label_desc.set_text("");
     label_desc.set_name("description");
     description = &label_desc;
@@ -65,6 +74,12 @@ bool MainWindow::on_key_press_event(GdkEventKey* key_event) {
         case GDK_KEY_Delete:
             this -> searchbox.set_text("");
             break;
+        case GDK_KEY_Menu:
+            if (auto* box = dynamic_cast<GridBox*>(this -> get_focus())) {
+                this -> show_actions(*box);
+                return true;
+            }
+            break;
         case GDK_KEY_Return:
         case GDK_KEY_Left:
         case GDK_KEY_Right:
@@ -88,20 +103,194 @@ bool MainWindow::on_key_press_event(GdkEventKey* key_event) {
     return Gtk::Window::on_key_press_event(key_event);
 }
 
-void MainWindow::filter_view() {
+/*
+ * Returns the box of the entry, creating it on first use
+ * */
+GridBox& MainWindow::get_box(std::uint32_t id) {
+    auto& box = this -> indexed_boxes[id];
+    if (!box) {
+        auto& entry = this -> entries[id];
+        auto& ab = this -> all_boxes.emplace_back(entry.name, entry.exec, entry.comment, false);
+        ab.entry = &entry;
+        Gtk::Image* image = app_image(*this -> icon_theme.get(), entry.icon);
+        ab.set_image_position(Gtk::POS_TOP);
+        ab.set_image(*image);
+        ab.show();
+        box = &ab;
+    }
+    return *box;
+}
+
+/*
+ * Launches the command in the background
+ * */
+static void launch(std::string_view exec) {
+    std::string cmd {exec};
+    cmd.append(" &");
+    std::system(cmd.data());
+}
+
+/*
+ * Pops the desktop actions of the box's entry up; they are only parsed now
+ * */
+void MainWindow::show_actions(GridBox& box) {
+    if (!box.entry || box.entry -> actions.empty()) {
+        return;
+    }
+    for (auto* child : this -> actions_box.get_children()) {
+        this -> actions_box.remove(*child);
+    }
+    for (auto& ref : box.entry -> actions) {
+        auto action = desktop_action(*box.entry, ref, this -> lang);
+        if (action.name.empty() || action.exec.empty()) {
+            continue;
+        }
+        auto* button = Gtk::manage(new Gtk::ModelButton());
+        button -> property_text() = action.name;
+        button -> signal_clicked().connect([this, exec = std::move(action.exec)]() {
+            launch(exec);
+            this -> quit();
+        });
+        this -> actions_box.pack_start(*button, false, false);
+    }
+    if (this -> actions_box.get_children().empty()) {
+        return;
+    }
+    this -> actions_box.show_all();
+    this -> actions_popover.set_relative_to(box);
+    this -> actions_popover.set_position(Gtk::POS_BOTTOM);
+    this -> actions_popover.popup();
+}
+
+/*
+ * Creates tabs for non-empty categories and displays the first one
+ * */
+void MainWindow::build_categories() {
+    Gtk::RadioButton::Group group;
+    bool first = true;
+    for (std::size_t i = 0; i < main_categories.size(); i++) {
+        if (this -> corpus -> category_ids[i].empty()) {
+            continue;
+        }
+        auto label = main_categories[i].label;
+        auto* button = Gtk::manage(new Gtk::RadioButton(group, Glib::ustring(label.begin(), label.end())));
+        button -> set_mode(false);
+        button -> set_name("category");
+        button -> signal_toggled().connect([this, button, i]() {
+            if (button -> get_active()) {
+                this -> show_category(i);
+            }
+        });
+        this -> categories_box.pack_start(*button, false, false);
+        if (first) {
+            this -> category = i;
+            first = false;
+        }
+    }
+}
+
+/*
+ * Displays entries of the category; their boxes are only built now
+ * */
+void MainWindow::show_category(std::size_t index) {
+    this -> category = index;
+    if (this -> searchbox.get_text().empty()) {
+        this -> on_search_changed();
+    } else {
+        // on_search_changed will follow
+        this -> searchbox.set_text("");
+    }
+}
+
+/*
+ * Starts creating boxes of all entries in the background; by category they are created per page instead
+ * */
+void MainWindow::populate() {
+    if (!this -> by_category) {
+        this -> populate_idle = Glib::signal_idle().connect(sigc::mem_fun(*this, &MainWindow::on_populate));
+    }
+}
+
+/*
+ * Creates boxes within the per-frame time budget and appends them to the unfiltered view,
+ * returns true until all the entries are done
+ * */
+bool MainWindow::on_populate() {
+    auto deadline = std::chrono::steady_clock::now() + FRAME_BUDGET;
+    bool unfiltered = this -> searchbox.get_text().empty();
+    bool first_batch = this -> populated == 0;
+    this -> apps_grid.freeze_child_notify();
+    while (this -> populated < this -> entries.size() && std::chrono::steady_clock::now() < deadline) {
+        auto id = this -> populated++;
+        auto& box = this -> get_box(id);
+        // the unfiltered view holds the populated entries in order, the new one goes last
+        if (unfiltered) {
+            this -> apps_grid.attach(box, id % num_col, id / num_col, 1, 1);
+        }
+    }
+    this -> apps_grid.thaw_child_notify();
+    if (first_batch && unfiltered && this -> fav_boxes.empty() && this -> pinned_boxes.empty()) {
+        auto* first = this -> apps_grid.get_child_at(0, 0);
+        if (first) {
+            first -> grab_focus();
+        }
+    }
+    return this -> populated < this -> entries.size();
+}
+
+/*
+ * Hands the phrase over to the search worker, only the latest phrase gets applied
+ * */
+void MainWindow::on_search_changed() {
+    // keystrokes coming faster than the search cancel the outdated work
+    this -> generation++;
+    this -> filter_idle.disconnect();
+    this -> found.clear();
+    this -> found_built = 0;
     auto search_phrase = searchbox.get_text();
-    if (search_phrase.size() > 0) {
-        this -> filtered_boxes.clear();
+    if (search_phrase.empty()) {
+        this -> filter_idle = Glib::signal_idle().connect(sigc::mem_fun(*this, &MainWindow::filter_view),
+                                                          Glib::PRIORITY_HIGH_IDLE);
+    } else {
+        this -> worker.search(this -> generation, search_phrase.raw(), this -> corpus);
+    }
+}
+
+/*
+ * Receives results from the worker, drops outdated ones
+ * */
+void MainWindow::on_search_done() {
+    auto result = this -> worker.take_result();
+    if (!result || result -> generation != this -> generation) {
+        return;
+    }
+    this -> found = std::move(result -> ids);
+    this -> found_built = 0;
+    this -> filter_idle.disconnect();
+    this -> filter_idle = Glib::signal_idle().connect(sigc::mem_fun(*this, &MainWindow::filter_view),
+                                                      Glib::PRIORITY_HIGH_IDLE);
+}
 
-        auto phrase = search_phrase.casefold();
-        for (auto& box : this -> all_boxes) {
-            if (box.name.casefold().find(phrase) != Glib::ustring::npos ||
-                box.exec.casefold().find(phrase) != Glib::ustring::npos ||
-                box.comment.casefold().find(phrase) != Glib::ustring::npos)
-            {
-                this -> filtered_boxes.emplace_back(&box);
+/*
+ * Applies the latest search results within the per-frame time budget,
+ * returns true to be resumed on the next idle
+ * */
+bool MainWindow::filter_view() {
+    auto deadline = std::chrono::steady_clock::now() + FRAME_BUDGET;
+    auto search_phrase = searchbox.get_text();
+    if (search_phrase.size() > 0) {
+        // ids come in the order of entries; creating boxes (and loading icons) takes time
+        while (this -> found_built < this -> found.size()) {
+            this -> get_box(this -> found[this -> found_built++]);
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return true;
             }
         }
+
+        this -> filtered_boxes.clear();
+        for (auto id : this -> found) {
+            this -> filtered_boxes.emplace_back(&this -> get_box(id));
+        }
         this -> favs_grid.hide();
         this -> separator.hide();
         this -> rebuild_grid(true);
@@ -115,6 +304,7 @@ void MainWindow::filter_view() {
     if (first) {
         first -> grab_focus();
     }
+    return false;
 }
 
 void MainWindow::rebuild_grid(bool filtered) {
@@ -142,9 +332,25 @@ void MainWindow::rebuild_grid(bool filtered) {
         if (this -> fav_boxes.size() > 0) {
             fav_boxes.front().grab_focus();
         }
+    } else if (this -> by_category) {
+        for (auto id : this -> corpus -> category_ids[this -> category]) {
+            this -> apps_grid.attach(this -> get_box(id), column, row, 1, 1);
+            if (column < num_col - 1) {
+                column++;
+            } else {
+                column = 0;
+                row++;
+            }
+            cnt++;
+        }
+        auto* first = this -> apps_grid.get_child_at(0, 0);
+        if (first) {
+            first -> grab_focus();
+        }
     } else {
-        for (auto& box : this -> all_boxes) {
-            this -> apps_grid.attach(box, column, row, 1, 1);
+        // in the order of entries, as far as populated; searches may have built others already
+        for (std::uint32_t id = 0; id < this -> populated; id++) {
+            this -> apps_grid.attach(this -> get_box(id), column, row, 1, 1);
             if (column < num_col - 1) {
                 column++;
             } else {
@@ -154,36 +360,110 @@ void MainWindow::rebuild_grid(bool filtered) {
             cnt++;
         }
         // Set keyboard focus to the first visible button
-        if (this -> all_boxes.size() > 0) {
-            all_boxes.front().grab_focus();
+        auto* first = this -> apps_grid.get_child_at(0, 0);
+        if (first) {
+            first -> grab_focus();
         }
     }
     this -> apps_grid.thaw_child_notify();
 }
 
-GridBox::GridBox(Glib::ustring name, Glib::ustring exec, Glib::ustring comment, bool pinned)
- : AppBox(std::move(name), std::move(exec), std::move(comment)), pinned(pinned) {}
+SearchWorker::SearchWorker(): thread(&SearchWorker::run, this) {}
+
+SearchWorker::~SearchWorker() {
+    {
+        std::lock_guard lock {mutex};
+        stopping = true;
+    }
+    wakeup.notify_one();
+    thread.join();
+}
+
+/*
+ * Requests a search, replacing the pending request if any
+ * */
+void SearchWorker::search(std::uint64_t generation, std::string phrase, std::shared_ptr<const SearchCorpus> corpus) {
+    {
+        std::lock_guard lock {mutex};
+        request = Request { generation, std::move(phrase), std::move(corpus) };
+        latest = generation;
+    }
+    wakeup.notify_one();
+}
+
+/*
+ * Returns the newest result not taken yet
+ * */
+std::optional<SearchWorker::Result> SearchWorker::take_result() {
+    std::lock_guard lock {mutex};
+    std::optional<Result> taken;
+    taken.swap(result);
+    return taken;
+}
+
+void SearchWorker::run() {
+    set_alloc_phase(StatsPhase::Search);
+    std::unique_lock lock {mutex};
+    while (true) {
+        wakeup.wait(lock, [this] { return stopping || request; });
+        if (stopping) {
+            return;
+        }
+        auto job = std::move(*request);
+        request.reset();
+        lock.unlock();
+
+        // "c:<category> words" searches the category only
+        std::string_view phrase {job.phrase};
+        const std::vector<std::uint32_t>* within = nullptr;
+        static const std::vector<std::uint32_t> none;
+        if (phrase.substr(0, 2) == "c:") {
+            auto end = std::min(phrase.find_first_of(" \t"), phrase.size());
+            auto c = find_category(phrase.substr(2, end - 2));
+            within = c < main_categories.size() ? &job.corpus -> category_ids[c] : &none;
+            phrase.remove_prefix(end);
+        }
+        SearchIndex::Query query {job.corpus -> index, phrase, within};
+        bool outdated = false;
+        while (!query.step(FILTER_SLICE)) {
+            if (latest != job.generation || stopping) {
+                outdated = true;
+                break;
+            }
+        }
+
+        lock.lock();
+        if (!outdated) {
+            result = Result { job.generation, std::move(query.result) };
+            dispatcher.emit();
+        }
+    }
+}
+
+GridBox::GridBox(std::string_view name, std::string_view exec, std::string_view comment, bool pinned)
+ : AppBox(name, exec, comment), pinned(pinned) {}
 
 bool GridBox::on_button_press_event(GdkEventButton* event) {
     std::cout << event -> button << "\n";
     if (event -> button == 1) {
-        int clicks = 0;
-        try {
-            clicks = cache[exec];
-            clicks++;
-        } catch(...) {
-            clicks = 1;
-        }
-        cache[exec] = clicks;
-        save_json(cache, cache_file);
+        // clicks are counted for favourites only
+        if (!cache_file.empty()) {
+            cache[std::string(exec)]++;
+            save_json(cache, cache_file);
+        }
         this -> activate();
 
     } else if (pins && event -> button == 3) {
         if (pinned) {
-            remove_and_save_pinned(exec);
+            remove_and_save_pinned(std::string(exec));
         } else {
-            add_and_save_pinned(exec);
+            add_and_save_pinned(std::string(exec));
         }
+    } else if (event -> button == 3) {
+        // the right button pins entries in the -p mode, it opens the actions otherwise
+        auto toplevel = dynamic_cast<MainWindow*>(this -> get_toplevel());
+        toplevel -> show_actions(*this);
+        return true;
     }
     return false;
 }
@@ -191,18 +471,17 @@ bool GridBox::on_button_press_event(GdkEventButton* event) {
 bool GridBox::on_focus_in_event(GdkEventFocus* event) {
     (void) event; // suppress warning
 
-    description -> set_text(comment);
+    description -> set_text(Glib::ustring(comment.begin(), comment.end()));
     return true;
 }
 
 void GridBox::on_enter() {
-    description -> set_text(comment);
+    description -> set_text(Glib::ustring(comment.begin(), comment.end()));
     return AppBox::on_enter();
 }
 
 void GridBox::on_activate() {
-    exec.append(" &");
-    std::system(exec.data());
+    launch(exec);
     auto toplevel = dynamic_cast<MainWindow*>(this->get_toplevel());
     toplevel->quit();
 }
@@ -0,0 +1,203 @@
+/* GTK-based application grid
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "nwg_tools.h"
+#include "grid.h"
+
+/*
+ * Counters of the -stats mode. All of them are constant-initialized,
+ * so that they are usable by allocations made before main().
+ * Sizes are taken from malloc_usable_size, as unsized delete does not know them.
+ * */
+struct AllocCounters {
+    std::atomic<std::size_t> allocations {0};
+    std::atomic<std::size_t> bytes {0};
+    std::atomic<std::size_t> frees {0};
+    std::atomic<std::size_t> freed {0};
+};
+
+static constexpr std::array<std::string_view, static_cast<std::size_t>(StatsPhase::Count)> phase_names {
+    "main", "config", "cache", "scan", "parse", "index", "sway", "gtk", "window", "run", "search"
+};
+
+static std::atomic<bool> counting {false};
+static std::array<AllocCounters, phase_names.size()> counters {};
+static std::atomic<long long> live {0};     // may go below zero: blocks allocated before counting are freed too
+static std::atomic<long long> peak {0};
+static thread_local std::size_t current_phase = 0;
+
+static void count_allocation(void* ptr) {
+    auto size = malloc_usable_size(ptr);
+    auto& phase = counters[current_phase];
+    phase.allocations.fetch_add(1, std::memory_order_relaxed);
+    phase.bytes.fetch_add(size, std::memory_order_relaxed);
+    auto now = live.fetch_add(size, std::memory_order_relaxed) + static_cast<long long>(size);
+    auto top = peak.load(std::memory_order_relaxed);
+    while (now > top && !peak.compare_exchange_weak(top, now, std::memory_order_relaxed)) { }
+}
+
+static void count_free(void* ptr) {
+    auto size = malloc_usable_size(ptr);
+    auto& phase = counters[current_phase];
+    phase.frees.fetch_add(1, std::memory_order_relaxed);
+    phase.freed.fetch_add(size, std::memory_order_relaxed);
+    live.fetch_sub(size, std::memory_order_relaxed);
+}
+
+/*
+ * Replacements of the global allocation functions; the array and nothrow forms
+ * call these by default. GLib allocations are not seen, g_mem_set_vtable is a no-op since 2.46.
+ * */
+void* operator new(std::size_t size) {
+    void* ptr = std::malloc(size ? size : 1);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    if (counting.load(std::memory_order_relaxed)) {
+        count_allocation(ptr);
+    }
+    return ptr;
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    auto alignment = std::max(static_cast<std::size_t>(align), sizeof(void*));
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, size ? size : 1) != 0) {
+        throw std::bad_alloc();
+    }
+    if (counting.load(std::memory_order_relaxed)) {
+        count_allocation(ptr);
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    if (ptr && counting.load(std::memory_order_relaxed)) {
+        count_free(ptr);
+    }
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    if (ptr && counting.load(std::memory_order_relaxed)) {
+        count_free(ptr);
+    }
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    ::operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t align) noexcept {
+    ::operator delete(ptr, align);
+}
+
+/*
+ * Starts counting allocations, attributed to the phase of the allocating thread
+ * */
+void start_alloc_stats() {
+    counting = true;
+}
+
+/*
+ * Sets the phase further allocations of the calling thread are attributed to
+ * */
+void set_alloc_phase(StatsPhase phase) {
+    current_phase = static_cast<std::size_t>(phase);
+}
+
+AllocPhase::AllocPhase(StatsPhase phase): previous(static_cast<StatsPhase>(current_phase)) {
+    set_alloc_phase(phase);
+}
+
+AllocPhase::~AllocPhase() {
+    set_alloc_phase(previous);
+}
+
+/*
+ * Counts the widget and its descendants
+ * */
+static std::size_t count_widgets(Gtk::Widget& widget) {
+    std::size_t count = 1;
+    if (auto* container = dynamic_cast<Gtk::Container*>(&widget)) {
+        for (auto* child : container -> get_children()) {
+            count += count_widgets(*child);
+        }
+    }
+    return count;
+}
+
+/*
+ * Stops counting and returns the report of the -stats mode
+ * */
+ns::json memory_stats(MainWindow& window, const StringPool& strings) {
+    counting = false;
+
+    ns::json phases = ns::json::object();
+    for (std::size_t i = 0; i < phase_names.size(); i++) {
+        auto& phase = counters[i];
+        phases[std::string(phase_names[i])] = {
+            { "allocations", phase.allocations.load() },
+            { "bytes", phase.bytes.load() },
+            { "frees", phase.frees.load() },
+            { "freed_bytes", phase.freed.load() }
+        };
+    }
+    auto [pixbufs, pixbuf_bytes] = pixbuf_cache_usage();
+
+    return {
+        { "rss_kb", get_rss_kb() },
+        { "peak_rss_kb", get_peak_rss_kb() },
+        { "heap", { { "live_bytes", std::max(live.load(), 0LL) }, { "peak_bytes", peak.load() } } },
+        { "phases", std::move(phases) },
+        { "pixbufs", { { "count", pixbufs }, { "bytes", pixbuf_bytes } } },
+        { "widgets", {
+            { "in_window", count_widgets(window) },
+            { "app_boxes", window.all_boxes.size() },
+            { "favourite_boxes", window.fav_boxes.size() },
+            { "pinned_boxes", window.pinned_boxes.size() }
+        } },
+        { "entries", {
+            { "count", window.entries.size() },
+            { "bytes", window.entries.capacity() * sizeof(DesktopEntry) }
+        } },
+        { "strings", { { "bytes", strings.bytes() } } }
+    };
+}
+
+/*
+ * Prints the report of the -stats mode in a human readable form
+ * */
+void print_memory_stats(const ns::json& stats, std::ostream& out) {
+    auto flags = out.flags();
+    out << "RSS: " << stats["rss_kb"] << " kB, peak: " << stats["peak_rss_kb"] << " kB\n";
+    out << "Heap: " << stats["heap"]["live_bytes"] << " bytes live, peak: " << stats["heap"]["peak_bytes"] << " bytes\n";
+    out << std::left << std::setw(8) << "Phase" << std::right
+        << std::setw(12) << "allocs" << std::setw(14) << "bytes"
+        << std::setw(12) << "frees" << std::setw(14) << "freed" << '\n';
+    for (auto name : phase_names) {
+        auto& phase = stats["phases"][std::string(name)];
+        out << std::left << std::setw(8) << name << std::right
+            << std::setw(12) << phase["allocations"].get<std::size_t>() << std::setw(14) << phase["bytes"].get<std::size_t>()
+            << std::setw(12) << phase["frees"].get<std::size_t>() << std::setw(14) << phase["freed_bytes"].get<std::size_t>() << '\n';
+    }
+    out << "Pixbufs: " << stats["pixbufs"]["count"] << ", " << stats["pixbufs"]["bytes"] << " bytes\n";
+    auto& widgets = stats["widgets"];
+    out << "Widgets: " << widgets["in_window"] << " in window, app boxes: " << widgets["app_boxes"]
+        << ", favourites: " << widgets["favourite_boxes"] << ", pinned: " << widgets["pinned_boxes"] << '\n';
+    out << "Entries: " << stats["entries"]["count"] << ", " << stats["entries"]["bytes"] << " bytes, strings: "
+        << stats["strings"]["bytes"] << " bytes\n";
+    out.flags(flags);
+}
@@ -0,0 +1,161 @@
+/*
+ * Entry text memory benchmark: the heap taken by parsed desktop entries, their fields
+ * either in a StringPool or, as before it, each one in its own std::string
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <malloc.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include "check.h"
+#include "nwg_core.h"
+
+namespace fs = std::filesystem;
+
+// DesktopEntry as it was before the StringPool, with the fields it has now
+struct OwningEntry {
+    std::string name;
+    std::string exec;
+    std::string icon;
+    std::string comment;
+    std::string mime_type;
+    std::string generic_name;
+    std::string keywords;
+    std::string categories;
+    std::string try_exec;
+    std::string only_show_in;
+    std::string not_show_in;
+    std::string path;
+    std::vector<ActionRef> actions {};
+    bool no_display {false};
+    bool hidden {false};
+};
+
+// The text nwggrid boxes kept: their own copies before, views now
+struct OwningBox {
+    std::string name;
+    std::string exec;
+    std::string comment;
+};
+
+struct ViewBox {
+    std::string_view name;
+    std::string_view exec;
+    std::string_view comment;
+};
+
+static std::size_t heap_in_use() {
+    auto info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+/*
+ * Writes count .desktop files alike those of a desktop with flatpaks and wine and Steam games:
+ * commands, icons and mime types repeat across them
+ * */
+static void write_entries(const fs::path& dir, std::size_t count, std::mt19937& rng) {
+    fs::create_directories(dir);
+    std::vector<std::string> mime_types;
+    for (int i = 0; i < 12; i++) {
+        std::string types;
+        for (int t = 0; t < 5 + static_cast<int>(rng() % 30); t++) {
+            types += "application/x-" + random_text(rng, 4 + rng() % 10, "abcdefghijklmnopqrstuvwxyz") + ';';
+        }
+        mime_types.push_back(types);
+    }
+    for (std::size_t i = 0; i < count; i++) {
+        auto word = random_text(rng, 5 + rng() % 8, "abcdefghijklmnopqrstuvwxyz");
+        std::string exec;
+        switch (rng() % 4) {
+            case 0:
+                exec = "/usr/bin/flatpak run --branch=stable --arch=x86_64 --command=" + word + " org." + word + ".App";
+                break;
+            case 1:
+                exec = "env WINEPREFIX=\"/home/user/.wine\" wine C:\\\\Program\\ Files\\\\" + word + ".exe";
+                break;
+            case 2:
+                exec = "steam steam://rungameid/" + std::to_string(rng() % 1000000);
+                break;
+            default:
+                // an alternative entry of a program, as of a -private or -wayland variant
+                exec = "firefox";
+        }
+        std::ofstream file(dir / (word + std::to_string(i) + ".desktop"));
+        file << "[Desktop Entry]\nType=Application\nName=" << word << " " << i << '\n';
+        for (auto lang : {"de", "fr", "pl", "es"}) {
+            file << "Name[" << lang << "]=" << word << ' ' << lang << '\n';
+        }
+        file << "GenericName=Application\nComment=" << random_text(rng, 20 + rng() % 60, "abcdefgh ") << '\n'
+             << "Exec=" << exec << " %U\n"
+             << "Icon=" << (rng() % 3 ? "wine" : word) << '\n'
+             << "Categories=Game;\nKeywords=" << word << ";\n";
+        if (rng() % 2) {
+            file << "MimeType=" << mime_types[rng() % mime_types.size()] << '\n';
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> dirs;
+    fs::path generated;
+    if (argc > 1) {
+        dirs.assign(argv + 1, argv + argc);
+    } else {
+        char dir_template[] = "/tmp/nwg-bench-XXXXXX";
+        CHECK(mkdtemp(dir_template) != nullptr);
+        generated = dir_template;
+        std::mt19937 rng(32);
+        write_entries(generated / "applications", 2000, rng);
+        dirs.push_back((generated / "applications").string());
+    }
+    auto paths = list_entries(dirs);
+    std::cout << paths.size() << " .desktop files\n";
+
+    auto before_pool = heap_in_use();
+    StringPool strings;
+    auto entries = load_entries(std::move(paths), "pl", strings);
+    strings.drop_index();
+    auto pooled_entries = heap_in_use() - before_pool;
+    std::vector<ViewBox> view_boxes;
+    view_boxes.reserve(entries.size());
+    for (auto& entry : entries) {
+        view_boxes.push_back({entry.name, entry.exec, entry.comment});
+    }
+    auto pooled = heap_in_use() - before_pool;
+
+    auto before_owning = heap_in_use();
+    std::vector<OwningEntry> owning;
+    owning.reserve(entries.size());
+    for (auto& e : entries) {
+        owning.push_back({std::string(e.name), std::string(e.exec), std::string(e.icon), std::string(e.comment),
+                          std::string(e.mime_type), std::string(e.generic_name), std::string(e.keywords),
+                          std::string(e.categories), std::string(e.try_exec), std::string(e.only_show_in),
+                          std::string(e.not_show_in), std::string(e.path), e.actions, e.no_display, e.hidden});
+    }
+    auto owning_entries = heap_in_use() - before_owning;
+    std::vector<OwningBox> owning_boxes;
+    owning_boxes.reserve(owning.size());
+    for (auto& entry : owning) {
+        owning_boxes.push_back({entry.name, entry.exec, entry.comment});
+    }
+    auto owning_total = heap_in_use() - before_owning;
+
+    std::cout << entries.size() << " entries of " << sizeof(DesktopEntry) << " B, were " << sizeof(OwningEntry)
+              << " B; " << strings.bytes() << " B of text in the pool\n"
+              << "std::string fields: " << owning_entries << " B entries, "
+              << owning_total << " B with box copies\n"
+              << "StringPool views:   " << pooled_entries << " B entries, "
+              << pooled << " B with box views\n";
+
+    if (!generated.empty()) {
+        fs::remove_all(generated);
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * Matcher benchmark: serial and pooled find over long inputs
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <numeric>
+
+#include "check.h"
+#include "nwg_core.h"
+
+int main() {
+    std::mt19937 rng(4);
+    constexpr std::string_view words[] {
+        "fix", "add", "remove", "update", "grid", "dmenu", "bar", "cache",
+        "icon", "search", "parser", "window", "refactor", "build", "meson"
+    };
+    ThreadPool pool;
+    std::cout << "threads: " << pool.size() << '\n';
+    for (std::size_t count : {std::size_t(10000), std::size_t(100000), std::size_t(500000)}) {
+        // git log --oneline alike lines
+        LineArena lines;
+        for (std::size_t i = 0; i < count; i++) {
+            auto line = random_text(rng, 8, "0123456789abcdef");
+            for (auto w = 3 + rng() % 6; w > 0; w--) {
+                line += ' ';
+                line += words[rng() % std::size(words)];
+            }
+            lines.add(line);
+        }
+        LineArena folded;
+        for (std::size_t i = 0; i < lines.size(); i++) {
+            folded.add_folded(lines[i]);
+        }
+        std::vector<std::size_t> order(lines.size());
+        std::iota(order.begin(), order.end(), 0);
+        auto line_at = [&folded](std::size_t i) { return folded[i]; };
+
+        for (auto phrase : {"se", "meson build", "zzz"}) {
+            Matcher matcher(phrase, false);
+            std::vector<std::size_t> results;
+            auto serial = time_per_call(20, [&] {
+                results.clear();
+                matcher.find(order, line_at, 20, results);
+            });
+            auto pooled = time_per_call(20, [&] {
+                results.clear();
+                matcher.find(pool, order, line_at, 20, results);
+            });
+            std::cout << count << " lines, \"" << phrase << "\": serial " << serial / 1000
+                      << " us, pooled " << pooled / 1000 << " us\n";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+/*
+ * find_text benchmark: std::string_view::find, the block kernel and find_text by haystack size
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <vector>
+
+#include "check.h"
+#include "text_search.h"
+
+int main() {
+    std::mt19937 rng(2);
+    constexpr std::string_view needles[] {"set", "fire", "manager", "er", "zq"};
+    constexpr std::size_t REPEAT = 200;
+    std::cout << "bytes  string_view::find  find_text_blocks  find_text (ns per call)\n";
+    for (std::size_t size : {16, 24, 32, 40, 48, 56, 64, 96, 128, 256, 1024}) {
+        std::vector<std::string> haystacks(2000);
+        for (auto& haystack : haystacks) {
+            haystack = random_text(rng, size, "abcdefghijklmnopqrstuvwxyz -.");
+        }
+        volatile std::size_t sink = 0;
+        auto run = [&](auto find) {
+            return time_per_call(REPEAT, [&] {
+                for (auto needle : needles) {
+                    for (auto& haystack : haystacks) {
+                        sink = sink + find(haystack, needle);
+                    }
+                }
+            }) / (std::size(needles) * haystacks.size());
+        };
+        auto std_find = run([](std::string_view h, std::string_view n) { return h.find(n); });
+        auto blocks = run([](std::string_view h, std::string_view n) {
+            return n.size() <= h.size() ? find_text_blocks(h, n) : h.find(n);
+        });
+        auto text = run([](std::string_view h, std::string_view n) { return find_text(h, n); });
+        std::cout << size << "  " << std_find << "  " << blocks << "  " << text << '\n';
+    }
+    return 0;
+}
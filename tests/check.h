@@ -0,0 +1,51 @@
+/*
+ * Checks for the nwg-launchers tests
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#pragma once
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+/*
+ * Fails the test with the location and the condition, if the condition does not hold
+ * */
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ':' << __LINE__ << ": CHECK failed: " #condition "\n"; \
+            std::exit(EXIT_FAILURE); \
+        } \
+    } while (0)
+
+/*
+ * Random text out of the alphabet, for tests and benchmarks to be repeatable
+ * */
+inline std::string random_text(std::mt19937& rng, std::size_t size, std::string_view alphabet) {
+    std::string text(size, ' ');
+    for (auto& c : text) {
+        c = alphabet[rng() % alphabet.size()];
+    }
+    return text;
+}
+
+/*
+ * Returns nanoseconds per call of f, averaged over calls
+ * */
+template <typename F>
+double time_per_call(std::size_t calls, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < calls; i++) {
+        f();
+    }
+    std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+    return took.count() / calls;
+}
@@ -0,0 +1,110 @@
+/*
+ * Desktop entry scanner and parser tests, over files written to a temporary directory
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include "check.h"
+#include "nwg_core.h"
+
+namespace fs = std::filesystem;
+
+static void write_file(const fs::path& path, std::string_view content) {
+    fs::create_directories(path.parent_path());
+    std::ofstream(path) << content;
+}
+
+static const DesktopEntry* find_entry(const std::vector<DesktopEntry>& entries, std::string_view name) {
+    for (auto& entry : entries) {
+        if (entry.name == name) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+int main() {
+    char dir_template[] = "/tmp/nwg-test-XXXXXX";
+    CHECK(mkdtemp(dir_template) != nullptr);
+    fs::path root {dir_template};
+    auto user = root / "user" / "applications";
+    auto system = root / "system" / "applications";
+
+    write_file(user / "app.desktop",
+        "[Desktop Entry]\nName=App\nName[pl]=Aplikacja\nExec=app %U\nIcon=app-icon\n"
+        "Comment=An app\nCategories=Network;WebBrowser;\nKeywords=web;\n"
+        "Actions=new-window;private;missing;\n\n"
+        "[Desktop Action new-window]\nName=New Window\nName[pl]=Nowe okno\nExec=app --new-window %u\n\n"
+        "[Desktop Action private]\nName=Private\nExec=app --private\nIcon=app-private\n");
+    // the user's file of the same desktop file ID shadows the system one
+    write_file(system / "app.desktop", "[Desktop Entry]\nName=System App\nExec=system-app\n");
+    write_file(system / "hidden.desktop", "[Desktop Entry]\nName=Hidden\nExec=hidden\n");
+    write_file(user / "hidden.desktop", "[Desktop Entry]\nName=Hidden\nExec=hidden\nHidden=true\n");
+    write_file(system / "nodisplay.desktop", "[Desktop Entry]\nName=NoDisplay\nExec=nd\nNoDisplay=true\n");
+    write_file(system / "installed.desktop", "[Desktop Entry]\nName=Installed\nExec=tool\nTryExec=nwg-test-tool\n");
+    write_file(system / "missing.desktop", "[Desktop Entry]\nName=Missing\nExec=gone\nTryExec=nwg-test-gone\n");
+    write_file(system / "only.desktop", "[Desktop Entry]\nName=Only\nExec=only\nOnlyShowIn=GNOME;sway;\n");
+    write_file(system / "other.desktop", "[Desktop Entry]\nName=Other\nExec=other\nOnlyShowIn=KDE;\n");
+    write_file(system / "not.desktop", "[Desktop Entry]\nName=Not\nExec=not\nNotShowIn=sway;\n");
+    write_file(system / "sub" / "nested.desktop", "[Desktop Entry]\nName=Nested\nExec=nested\n");
+    write_file(system / "noexec.desktop", "[Desktop Entry]\nName=No Exec\n");
+
+    auto bin = root / "bin";
+    write_file(bin / "nwg-test-tool", "#!/bin/sh\n");
+    chmod((bin / "nwg-test-tool").c_str(), 0755);
+    setenv("PATH", bin.c_str(), 1);
+    setenv("XDG_CURRENT_DESKTOP", "sway", 1);
+
+    auto paths = list_entries({user.string(), system.string()});
+    CHECK(paths.size() == 10);
+
+    StringPool strings;
+    auto entries = load_entries(std::move(paths), "pl", strings);
+
+    auto* app = find_entry(entries, "Aplikacja");
+    CHECK(app != nullptr);
+    CHECK(app -> exec == "app");
+    CHECK(app -> icon == "app-icon");
+    CHECK(app -> comment == "An app");
+    CHECK(entry_categories(app -> categories) == std::vector<std::size_t>{5});
+    CHECK(find_entry(entries, "System App") == nullptr);
+
+    CHECK(find_entry(entries, "Hidden") == nullptr);
+    CHECK(find_entry(entries, "NoDisplay") != nullptr && find_entry(entries, "NoDisplay") -> no_display);
+    CHECK(find_entry(entries, "Installed") != nullptr);
+    CHECK(find_entry(entries, "Missing") == nullptr);
+    CHECK(find_entry(entries, "Only") != nullptr);
+    CHECK(find_entry(entries, "Other") == nullptr);
+    CHECK(find_entry(entries, "Not") == nullptr);
+    CHECK(find_entry(entries, "Nested") != nullptr);
+    CHECK(find_entry(entries, "No Exec") == nullptr);
+    CHECK(std::is_sorted(entries.begin(), entries.end(), [](auto& a, auto& b) { return a.name < b.name; }));
+
+    // actions: offsets only, in the Actions= order; details parsed on demand
+    CHECK(app -> actions.size() == 2);
+    CHECK(app -> actions[0].id == "new-window" && app -> actions[1].id == "private");
+    auto new_window = desktop_action(*app, app -> actions[0], "pl");
+    CHECK(new_window.name == "Nowe okno");
+    CHECK(new_window.exec == "app --new-window");
+    auto private_window = desktop_action(*app, app -> actions[1], "en");
+    CHECK(private_window.name == "Private");
+    CHECK(private_window.icon == "app-private");
+
+    // an edited file: the group is found by its header
+    write_file(user / "app.desktop",
+        "[Desktop Entry]\nName=App\nExec=app\n\n[Desktop Action private]\nName=Private again\nExec=app -p\n");
+    CHECK(desktop_action(*app, app -> actions[1], "en").name == "Private again");
+    CHECK(desktop_action(*app, app -> actions[0], "en").name.empty());
+
+    fs::remove_all(root);
+    return 0;
+}
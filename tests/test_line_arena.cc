@@ -0,0 +1,52 @@
+/*
+ * LineArena tests
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include "check.h"
+#include "nwg_core.h"
+
+int main() {
+    LineArena lines;
+    CHECK(lines.empty());
+
+    // split as std::getline would: no empty line after the last newline
+    lines.assign("b\nA\n\nc");
+    CHECK(lines.size() == 4);
+    CHECK(lines[0] == "b" && lines[1] == "A" && lines[2] == "" && lines[3] == "c");
+    lines.assign("x\n");
+    CHECK(lines.size() == 1 && lines[0] == "x");
+    lines.assign("\n");
+    CHECK(lines.size() == 1 && lines[0] == "");
+    lines.assign("");
+    CHECK(lines.empty());
+
+    // invalid UTF-8 is repaired per line, valid lines are kept as they are
+    lines.assign("ok\nbad\xff\xfe\nza\xc5\xbc\xc3\xb3\xc5\x82\xc4\x87\n");
+    CHECK(lines.size() == 3);
+    CHECK(lines[0] == "ok");
+    CHECK(lines[1].substr(0, 3) == "bad" && lines[1].find('\xff') == std::string_view::npos);
+    CHECK(lines[2] == "za\xc5\xbc\xc3\xb3\xc5\x82\xc4\x87");
+
+    lines.assign("b\nA\nc\n");
+    lines.permute({2, 0, 1});
+    CHECK(lines[0] == "c" && lines[1] == "b" && lines[2] == "A");
+
+    LineArena folded;
+    for (std::size_t i = 0; i < lines.size(); i++) {
+        folded.add_folded(lines[i]);
+    }
+    CHECK(folded.size() == 3 && folded[2] == "a");
+    folded.add_folded("\xc5\xbb\xc3\x93\xc5\x81W");
+    CHECK(folded[3] == "\xc5\xbc\xc3\xb3\xc5\x82w");
+
+    folded.add("line\nwith a newline");
+    CHECK(folded[4] == "line\nwith a newline");
+    folded.clear();
+    CHECK(folded.empty());
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Matcher tests: serial and pooled find against a plain reference
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <algorithm>
+#include <numeric>
+
+#include "check.h"
+#include "nwg_core.h"
+
+/*
+ * What Matcher::find is meant to return: prefix matches in order, then substring matches, max in total
+ * */
+static std::vector<std::size_t> reference(const LineArena& folded, const std::vector<std::size_t>& order,
+                                          const std::string& phrase, std::size_t max) {
+    std::vector<std::size_t> prefix, substring;
+    for (auto i : order) {
+        auto pos = folded[i].find(phrase);
+        if (pos == 0) {
+            prefix.push_back(i);
+        } else if (pos != std::string_view::npos) {
+            substring.push_back(i);
+        }
+    }
+    prefix.insert(prefix.end(), substring.begin(), substring.end());
+    prefix.resize(std::min(prefix.size(), max));
+    return prefix;
+}
+
+int main() {
+    std::mt19937 rng(1);
+    // a small alphabet, so that short phrases match often, both as prefixes and inside lines
+    constexpr std::string_view alphabet {"abcdeABCDE -"};
+    LineArena lines;
+    for (std::size_t i = 0; i < 2 * PARALLEL_FIND_MIN; i++) {
+        lines.add(random_text(rng, 1 + rng() % 40, alphabet));
+    }
+    LineArena folded;
+    for (std::size_t i = 0; i < lines.size(); i++) {
+        folded.add_folded(lines[i]);
+    }
+    std::vector<std::size_t> order(lines.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+    auto line_at = [&folded](std::size_t i) { return folded[i]; };
+
+    // chunks are matched in parallel whatever the CPU count of the machine running the test
+    ThreadPool pool(4);
+    std::vector<std::size_t> serial, pooled;
+    for (int round = 0; round < 200; round++) {
+        auto phrase = random_text(rng, 1 + rng() % 5, alphabet);
+        Matcher matcher(phrase, false);
+        for (std::size_t max : {std::size_t(1), std::size_t(20), lines.size()}) {
+            auto expected = reference(folded, order, fold_case(phrase), max);
+            serial.clear();
+            matcher.find(order, line_at, max, serial);
+            CHECK(serial == expected);
+            pooled.clear();
+            matcher.find(pool, order, line_at, max, pooled);
+            CHECK(pooled == expected);
+        }
+    }
+
+    // case sensitive phrases are not folded
+    Matcher sensitive("AB", true);
+    CHECK(sensitive.match("ABC") == Matcher::PREFIX);
+    CHECK(sensitive.match("xABC") == Matcher::SUBSTRING);
+    CHECK(sensitive.match("abc") == Matcher::NONE);
+    Matcher insensitive("AB", false);
+    CHECK(insensitive.match("abc") == Matcher::PREFIX);
+
+    // results are appended to what the caller has already
+    std::vector<std::size_t> results {42};
+    Matcher("a", false).find(order, line_at, 3, results);
+    CHECK(results.size() == 4 && results.front() == 42);
+    return 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * PrefixIndex tests: ranges of random sorted lines against a linear scan
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include "check.h"
+#include "nwg_core.h"
+
+int main() {
+    std::mt19937 rng(48);
+    // a small alphabet for prefixes to be shared, with bytes of either sign
+    constexpr std::string_view alphabet {"ab-.z\x01\x7f\xc5\xff", 9};
+    for (int round = 0; round < 200; round++) {
+        std::vector<std::string> sorted(rng() % 300);
+        for (auto& line : sorted) {
+            line = random_text(rng, rng() % 6, alphabet);
+        }
+        std::sort(sorted.begin(), sorted.end());
+        LineArena lines;
+        for (auto& line : sorted) {
+            lines.add(line);
+        }
+        PrefixIndex index;
+        CHECK(index.build(lines));
+
+        for (int query = 0; query < 100; query++) {
+            auto prefix = random_text(rng, 1 + rng() % 3, alphabet);
+            if (!sorted.empty() && rng() % 2) {
+                // a prefix of an existing line
+                auto& line = sorted[rng() % sorted.size()];
+                if (!line.empty()) {
+                    prefix = line.substr(0, 1 + rng() % line.size());
+                }
+            }
+            std::size_t start = sorted.size(), end = sorted.size();
+            for (std::size_t i = 0; i < sorted.size(); i++) {
+                if (sorted[i].compare(0, prefix.size(), prefix) == 0) {
+                    start = std::min(start, i);
+                    end = i + 1;
+                } else {
+                    // the matches are contiguous
+                    CHECK(start == sorted.size() || end <= i);
+                }
+            }
+            auto [found_start, found_end] = index.range(lines, prefix);
+            CHECK(found_end - found_start == end - start);
+            CHECK(start == end || found_start == start);
+        }
+    }
+
+    LineArena unsorted;
+    unsorted.add("b");
+    unsorted.add("a");
+    CHECK(!PrefixIndex().build(unsorted));
+    return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * read_file_to_string tests: regular files, empty and missing ones, files reporting no size
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <unistd.h>
+
+#include <fstream>
+
+#include "check.h"
+#include "nwg_core.h"
+
+int main() {
+    char name[] = "/tmp/nwg-test-XXXXXX";
+    int fd = mkstemp(name);
+    CHECK(fd >= 0);
+    close(fd);
+
+    CHECK(read_file_to_string(name).empty());
+
+    std::mt19937 rng(40);
+    for (std::size_t size : {1, 4095, 4096, 4097, 65536, 200000}) {
+        auto text = random_text(rng, size, "abc\n");
+        std::ofstream(name, std::ios::trunc) << text;
+        CHECK(read_file_to_string(name) == text);
+    }
+    unlink(name);
+    CHECK(read_file_to_string(name).empty());
+
+    // st_size of files in /proc is 0
+    auto status = read_file_to_string("/proc/self/status");
+    CHECK(status.compare(0, 5, "Name:") == 0);
+    CHECK(status.back() == '\n');
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * SearchIndex tests against a plain scan of the documents
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include <algorithm>
+#include <array>
+
+#include "check.h"
+#include "search_index.h"
+#include "text_search.h"
+
+using Document = std::array<std::string, 3>;
+
+/*
+ * Ids of documents having every word of the query in one of their fields
+ * */
+static std::vector<std::uint32_t> reference(const std::vector<Document>& documents, const std::string& query) {
+    std::vector<std::string> words;
+    for (std::size_t start = 0; start < query.size();) {
+        auto end = std::min(query.find(' ', start), query.size());
+        if (end > start) {
+            words.push_back(fold_case(std::string_view(query).substr(start, end - start)));
+        }
+        start = end + 1;
+    }
+    std::vector<std::uint32_t> ids;
+    for (std::uint32_t id = 0; id < documents.size(); id++) {
+        bool all = std::all_of(words.begin(), words.end(), [&](auto& word) {
+            return std::any_of(documents[id].begin(), documents[id].end(), [&](auto& field) {
+                return fold_case(field).find(word) != std::string::npos;
+            });
+        });
+        if (all) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+int main() {
+    std::mt19937 rng(2);
+    constexpr std::string_view alphabet {"abcdefgABCDEFG"};
+    std::vector<Document> documents;
+    SearchIndex index;
+    for (int i = 0; i < 2000; i++) {
+        auto& doc = documents.emplace_back();
+        for (auto& field : doc) {
+            field = random_text(rng, rng() % 30, alphabet);
+        }
+        CHECK(index.add({doc[0], doc[1], doc[2]}) == static_cast<std::uint32_t>(i));
+    }
+    CHECK(index.size() == documents.size());
+
+    for (int round = 0; round < 500; round++) {
+        std::string query = random_text(rng, 1 + rng() % 5, alphabet);
+        if (rng() % 2) {
+            query += ' ' + random_text(rng, 1 + rng() % 4, alphabet);
+        }
+        CHECK(index.search(query) == reference(documents, query));
+    }
+
+    // words do not match across fields
+    SearchIndex fields;
+    fields.add({"Fire", "fox"});
+    CHECK(fields.search("firefox").empty());
+    CHECK(fields.search("fire fox") == std::vector<std::uint32_t>{0});
+
+    // within restricts the search to the given ids
+    std::vector<std::uint32_t> within {0, 5, 7};
+    auto all = index.search("");
+    CHECK(all.size() == documents.size());
+    CHECK(index.search("", &within) == within);
+
+    // a query verified a slice at a time ends up with the same result
+    SearchIndex::Query query(index, "ab");
+    while (!query.step(7)) { }
+    CHECK(query.result == index.search("ab"));
+    return 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * find_text and fold_case tests
+ * Copyright (c) 2020 Piotr Miller
+ * e-mail: nwg.piotr@gmail.com
+ * Website: http://nwg.pl
+ * Project: https://github.com/nwg-piotr/nwg-launchers
+ * License: GPL3
+ * */
+
+#include "check.h"
+#include "text_search.h"
+
+int main() {
+    std::mt19937 rng(3);
+    // a small alphabet makes partial matches of the first and the last byte frequent
+    constexpr std::string_view alphabet {"abc"};
+    for (int i = 0; i < 300000; i++) {
+        auto haystack = random_text(rng, rng() % 300, alphabet);
+        std::string needle;
+        if (rng() % 2 && !haystack.empty()) {
+            auto start = rng() % haystack.size();
+            needle = haystack.substr(start, 1 + rng() % 40);
+        } else {
+            needle = random_text(rng, 1 + rng() % 12, alphabet);
+        }
+        std::string_view h {haystack}, n {needle};
+        CHECK(find_text(h, n) == h.find(n));
+        if (n.size() >= 2 && n.size() <= h.size()) {
+            CHECK(find_text_blocks(h, n) == h.find(n));
+        }
+    }
+
+    CHECK(find_text("", "a") == std::string_view::npos);
+    CHECK(find_text("abc", "") == 0);
+
+    CHECK(is_ascii("plain text 123"));
+    CHECK(!is_ascii("za\xc5\xbc\xc3\xb3\xc5\x82\xc4\x87 and more than eight bytes"));
+    CHECK(fold_case("MiXeD Case") == "mixed case");
+    CHECK(fold_case("\xc5\xbb\xc3\x93\xc5\x81W") == "\xc5\xbc\xc3\xb3\xc5\x82w");
+    std::string out = "kept ";
+    fold_case("ABC", out);
+    CHECK(out == "kept abc");
+    return 0;
+}